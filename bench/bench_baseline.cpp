@@ -0,0 +1,286 @@
+#include "parser_combinator.h"
+#include "grammars.h"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+using clk = std::chrono::steady_clock;
+
+/*! One way of computing a fixture's checksum over the whole input */
+struct Variant
+{
+  std::string name;                                    //!< printed name
+  std::function<long long(const std::string &)> run;   //!< checksum of the input
+};
+
+/*! Input generator and the variants computing the same checksum over it */
+struct Fixture
+{
+  std::string name;                                 //!< printed name
+  std::function<std::string(std::mt19937 &)> unit; //!< one record, inputs are repeated records
+  Variant combinator;                               //!< grammar built from the library
+  Variant handwritten;                              //!< recursive descent written by hand
+  std::vector<Variant> libraries;                   //!< std::regex and libc baselines
+};
+
+/*! Skip ascii whitespace */
+static void skip_spaces(const char *&p, const char *end)
+{
+  while (p < end && std::isspace((unsigned char)*p)) p++;
+}
+
+/*! Handwritten decimal, optionally signed */
+static int hand_int(const char *&p, const char *end, bool sign)
+{
+  const bool neg = sign && p < end && *p == '-';
+  if (neg) p++;
+  long long v = 0;
+  while (p < end && (unsigned)(*p - '0') < 10) v = v * 10 + (*p++ - '0');
+  return (int)(neg ? -v : v);
+}
+
+/*! Handwritten recursive descent evaluator of the calc language */
+struct HandCalc
+{
+  const char *p;   //!< cursor
+  const char *end; //!< end of input
+
+  int term()
+  {
+    skip_spaces(p, end);
+    int x;
+    if (*p == '(')
+    {
+      p++;
+      x = expr();
+      skip_spaces(p, end);
+      p++;
+    }
+    else
+      x = hand_int(p, end, true);
+    skip_spaces(p, end);
+    return x;
+  }
+  int factor()
+  {
+    int x = term();
+    while (p < end && (*p == '*' || *p == '/'))
+    {
+      const size_t op = *p++ == '*' ? 2 : 3;
+      x = calc_apply(x, op, term());
+    }
+    return x;
+  }
+  int expr()
+  {
+    int x = factor();
+    while (p < end && (*p == '+' || *p == '-'))
+    {
+      const size_t op = *p++ == '+' ? 0 : 1;
+      x = calc_apply(x, op, factor());
+    }
+    return x;
+  }
+};
+
+/*! Precedence climbing over tokens found by std::regex */
+struct RegexCalc
+{
+  std::vector<std::string> toks; //!< tokens
+  size_t i = 0;                  //!< cursor
+
+  int term()
+  {
+    if (toks[i] == "(")
+    {
+      i++;
+      const int x = expr();
+      i++;
+      return x;
+    }
+    return std::atoi(toks[i++].c_str());
+  }
+  int factor()
+  {
+    int x = term();
+    while (i < toks.size() && (toks[i] == "*" || toks[i] == "/"))
+    {
+      const size_t op = toks[i++] == "*" ? 2 : 3;
+      x = calc_apply(x, op, term());
+    }
+    return x;
+  }
+  int expr()
+  {
+    int x = factor();
+    while (i < toks.size() && (toks[i] == "+" || toks[i] == "-"))
+    {
+      const size_t op = toks[i++] == "+" ? 0 : 1;
+      x = calc_apply(x, op, factor());
+    }
+    return x;
+  }
+};
+
+/*! Sum the integers std::regex finds for a pattern, compiled patterns are cached */
+static long long regex_ints(const std::string &str, const char *pattern)
+{
+  static std::map<std::string, std::regex> cache;
+  auto it = cache.find(pattern);
+  if (it == cache.end()) it = cache.emplace(pattern, std::regex(pattern)).first;
+  long long sum = 0;
+  for (std::sregex_iterator m(str.begin(), str.end(), it->second), e; m != e; ++m) sum += std::atoi((*m)[0].str().c_str());
+  return sum;
+}
+
+/*! Integers one per line, summed */
+static Fixture integers(const char *name, const Parser<int> *p, bool sign)
+{
+  const Parser<long long> *sum = p->keep_left(char_match('\n'))->fold_many<long long>(0, [](long long a, int x) { return a + x; });
+  return {
+    name,
+    [sign](std::mt19937 &rng) { return (sign && rng() % 2 ? "-" : "") + std::to_string(rng() % 1000000000) + "\n"; },
+    {"combinator", [sum](const std::string &str) { return sum->parse(str); }},
+    {"handwritten", [sign](const std::string &str) {
+      long long total = 0;
+      for (const char *c = str.data(), *end = c + str.size(); c < end; c++) total += hand_int(c, end, sign);
+      return total;
+    }},
+    {
+      {"std::regex", [sign](const std::string &str) { return regex_ints(str, sign ? "-?[0-9]+" : "[0-9]+"); }},
+      {"strtol", [](const std::string &str) {
+        long long total = 0;
+        for (const char *c = str.c_str(), *end = c + str.size(); c < end; c++)
+        {
+          char *next;
+          total += (int)std::strtol(c, &next, 10);
+          c = next;
+        }
+        return total;
+      }},
+    },
+  };
+}
+
+/*! Identifiers separated by spaces, checksum is the total identifier length */
+static Fixture identifiers()
+{
+  const Parser<size_t> *len = ident->keep_left(char_match(' '))->fold_many<size_t>(0, [](size_t a, std::string_view v) { return a + v.size(); });
+  return {
+    "ident",
+    [](std::mt19937 &rng) {
+      std::string w = word(rng);
+      for (size_t k = 1; k < w.size(); k += 3) w[k] = '0' + rng() % 10;
+      return w + " ";
+    },
+    {"combinator", [len](const std::string &str) { return (long long)len->parse(str); }},
+    {"handwritten", [](const std::string &str) {
+      long long total = 0;
+      for (const char *c = str.data(), *end = c + str.size(); c < end; c++)
+      {
+        const char *b = c;
+        if ((unsigned)(*c - 'a') < 26)
+          while (c < end && std::isalnum((unsigned char)*c)) c++;
+        total += c - b;
+      }
+      return total;
+    }},
+    {
+      {"std::regex", [](const std::string &str) {
+        static const std::regex re("[a-z][a-zA-Z0-9]*");
+        long long total = 0;
+        for (std::sregex_iterator m(str.begin(), str.end(), re), e; m != e; ++m) total += m->length();
+        return total;
+      }},
+    },
+  };
+}
+
+/*! Calc expressions one per line, checksum is the sum of their values */
+static Fixture calculator()
+{
+  const Parser<long long> *sum = calc()->fold_many<long long>(0, [](long long a, int x) { return a + x; });
+  return {
+    "calc",
+    [](std::mt19937 &rng) { return expression(rng, 6) + "\n"; },
+    {"combinator", [sum](const std::string &str) { return sum->parse(str); }},
+    {"handwritten", [](const std::string &str) {
+      HandCalc c{str.data(), str.data() + str.size()};
+      long long total = 0;
+      skip_spaces(c.p, c.end);
+      while (c.p < c.end) total += c.expr();
+      return total;
+    }},
+    {
+      {"std::regex tokens", [](const std::string &str) {
+        static const std::regex re("[0-9]+|[-+*/()]|\\n");
+        long long total = 0;
+        RegexCalc c;
+        for (std::sregex_iterator m(str.begin(), str.end(), re), e; m != e; ++m)
+        {
+          if (m->str() != "\n")
+          {
+            c.toks.push_back(m->str());
+            continue;
+          }
+          c.i = 0;
+          total += c.expr();
+          c.toks.clear();
+        }
+        return total;
+      }},
+    },
+  };
+}
+
+/*! Seconds per run of a variant, repeated for at least min_seconds */
+static double time(const Variant &v, const std::string &input, long long &checksum)
+{
+  const double min_seconds = 0.2;
+  size_t runs = 0;
+  const clk::time_point t0 = clk::now();
+  double secs = 0;
+  while (secs < min_seconds || runs == 0)
+  {
+    checksum = v.run(input);
+    runs++;
+    secs = std::chrono::duration<double>(clk::now() - t0).count();
+  }
+  return secs / runs;
+}
+
+int main(int argc, char **argv)
+{
+  const size_t bytes = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4) << 20;
+  std::setvbuf(stdout, nullptr, _IONBF, 0);
+  std::printf("%-8s %-18s %10s %10s %14s\n", "fixture", "variant", "MB/s", "ns/byte", "comb/variant");
+  int status = 0;
+  for (const Fixture &f : {integers("nat", nat, false), integers("intg", intg, true), identifiers(), calculator()})
+  {
+    std::mt19937 rng(42);
+    std::string input;
+    while (input.size() < bytes) input += f.unit(rng);
+    long long expected, got;
+    const double comb = time(f.combinator, input, expected);
+    std::vector<const Variant *> all = {&f.combinator, &f.handwritten};
+    for (const Variant &v : f.libraries) all.push_back(&v);
+    for (const Variant *v : all)
+    {
+      const double secs = v == &f.combinator ? comb : time(*v, input, got);
+      const bool same = v == &f.combinator || got == expected;
+      std::printf("%-8s %-18s %10.2f %10.3f %14.2f%s\n", f.name.c_str(), v->name.c_str(), input.size() / secs / 1e6,
+        secs * 1e9 / input.size(), comb / secs, same ? "" : "  (checksum differs)");
+      if (!same) status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,59 @@
+#include "parser_combinator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace parser;
+using clk = std::chrono::steady_clock;
+
+/*! Deterministic tiny inputs alternating identifiers and integers */
+static std::vector<std::string> corpus(size_t n)
+{
+  std::mt19937 rng(42);
+  std::vector<std::string> res;
+  res.reserve(n);
+  for (size_t k = 0; k < n; k++)
+  {
+    std::string str = " ";
+    const size_t len = 1 + rng() % 12;
+    for (size_t j = 0; j < len; j++) str += 'a' + rng() % 26;
+    res.push_back(str + " ");
+  }
+  return res;
+}
+
+static double seconds(clk::time_point t0) { return std::chrono::duration<double>(clk::now() - t0).count(); }
+
+int main(int argc, char **argv)
+{
+  const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  const std::vector<std::string> strs = corpus(n);
+  const std::vector<std::string_view> views(strs.begin(), strs.end());
+  size_t bytes = 0;
+  for (const std::string &s : strs) bytes += s.size();
+  const Parser<std::string_view> *p = parsers::identifier;
+
+  clk::time_point t0 = clk::now();
+  size_t ok = 0;
+  for (const std::string &s : strs) ok += !p->parse(s).empty();
+  const double naive = seconds(t0);
+
+  sched::Pool &pool = sched::Pool::shared();
+  std::vector<uint64_t> lat;
+  t0 = clk::now();
+  std::vector<std::optional<std::string_view>> res = p->parse_batch(views, pool, &lat);
+  const double batch = seconds(t0);
+
+  std::printf("inputs %zu, bytes %zu, workers %zu, parsed %zu\n", n, bytes, pool.size(), ok);
+  std::printf("%-12s %12s %12s\n", "mode", "inputs/s", "MB/s");
+  std::printf("%-12s %12.0f %12.2f\n", "parse", n / naive, bytes / naive / 1e6);
+  std::printf("%-12s %12.0f %12.2f\n", "parse_batch", n / batch, bytes / batch / 1e6);
+  profile::Histogram h;
+  for (uint64_t ns : lat) h.record(ns);
+  std::printf("latency ns %s\n", h.summary().c_str());
+  return res.size() == n ? 0 : 1;
+}
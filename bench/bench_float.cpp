@@ -0,0 +1,67 @@
+#include "parser_combinator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+using clk = std::chrono::steady_clock;
+
+/*! Deterministic CSV of decimal and scientific numbers, eight columns per row */
+static std::string corpus(size_t bytes)
+{
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> dist(-1e4, 1e4);
+  std::string str;
+  str.reserve(bytes + 64);
+  char buf[64];
+  while (str.size() < bytes)
+  {
+    for (int col = 0; col < 8; col++)
+    {
+      const double v = dist(rng);
+      const int n = col % 4 == 3 ? std::snprintf(buf, sizeof(buf), "%.6e", v) : std::snprintf(buf, sizeof(buf), "%.4f", v);
+      str.append(buf, n);
+      str += col == 7 ? '\n' : ',';
+    }
+  }
+  return str;
+}
+
+/*! Sum every field of the csv, skipping the delimiter after each one */
+template <typename P>
+static double sum(const P *p, const std::string &str)
+{
+  state::StateView<> s(str);
+  double total = 0;
+  while (s.get_pos() < (int)str.size())
+  {
+    total += p->parse(s);
+    s.adv();
+  }
+  return total;
+}
+
+int main(int argc, char **argv)
+{
+  const size_t mb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100;
+  const std::string str = corpus(mb << 20);
+
+  const Parser<std::string_view> *sign = capture(char_match('-')->alt(empty));
+  const Parser<double> *composed =
+    capture(sign->seq(nat)->seq(char_match('.'))->seq(digit_some)->seq(capture(one_of_literals({"e+", "e-"})->seq(nat))->alt(empty)))
+    ->map<double>([](std::string_view v) { return std::stod(std::string(v)); });
+
+  std::printf("csv %zu MB\n%-10s %10s %10s %14s\n", mb, "parser", "MB/s", "ns/byte", "checksum");
+  for (std::pair<const char *, const Parser<double> *> b : {std::make_pair("real", real), std::make_pair("composed", composed)})
+  {
+    const clk::time_point t0 = clk::now();
+    const double total = sum(b.second, str);
+    const double secs = std::chrono::duration<double>(clk::now() - t0).count();
+    std::printf("%-10s %10.1f %10.3f %14.4f\n", b.first, str.size() / secs / 1e6, secs * 1e9 / str.size(), total);
+  }
+  return 0;
+}
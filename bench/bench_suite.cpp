@@ -0,0 +1,200 @@
+#define PARSER_ALLOC_HOOKS
+#include "parser_combinator.h"
+#include "perf_counters.h"
+#include "grammars.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+using clk = std::chrono::steady_clock;
+
+/*! Source a case is parsed from */
+enum class Source { view, string, istream };
+
+/*! One benchmark: a generator of records and a parse of a whole input */
+struct Case
+{
+  std::string name;                                //!< printed name
+  std::function<std::string(std::mt19937 &)> unit; //!< appends one record, inputs are repeated records
+  std::function<uint64_t(state::State<> &)> run;   //!< parses the whole input, returns a checksum
+  Source source = Source::view;                    //!< state implementation
+  size_t max = SIZE_MAX;                           //!< largest input size, for slow sources
+};
+
+/*! Run p over the whole source, counting values until it stops */
+template <typename T>
+static uint64_t each(const Parser<T> *p, state::State<> &s)
+{
+  uint64_t n = 0;
+  while (s.peek() >= 0)
+  {
+    p->parse(s);
+    n++;
+  }
+  return n;
+}
+
+static std::vector<Case> cases()
+{
+  const Parser<std::string_view> *kw = string_match("return");
+  const Parser<size_t> *words = letter->many()->keep_left(char_match(' '))->skip_many();
+  const Parser<size_t> *lines = nat->keep_left(char_match('\n'))->skip_many();
+  const Parser<size_t> *tokens = identifier->skip_many();
+  const Parser<size_t> *run = letter->skip_many();
+  const Parser<long long> *sums = calc()->fold_many<long long>(0, [](long long a, int x) { return a + x; });
+  const Parser<size_t> *lists = between(symbol("["), identifier->keep_left(symbol(",")->keep_right(identifier)->skip_many()), symbol("]"))->skip_many();
+  auto letters = [](std::mt19937 &rng) { return word(rng); };
+  return {
+    {"sat", letters, [](state::State<> &s) { return each(letter, s); }},
+    {"string_match", [](std::mt19937 &) { return std::string("return"); }, [kw](state::State<> &s) { return each(kw, s); }},
+    {"many", [](std::mt19937 &rng) { return word(rng) + " "; }, [words](state::State<> &s) { return words->parse(s); }},
+    {"nat", [](std::mt19937 &rng) { return std::to_string(rng() % 1000000000) + "\n"; }, [lines](state::State<> &s) { return lines->parse(s); }},
+    {"token", [](std::mt19937 &rng) { return word(rng) + (rng() % 2 ? " " : "\n  "); }, [tokens](state::State<> &s) { return tokens->parse(s); }},
+    {"state/view", letters, [run](state::State<> &s) { return run->parse(s); }, Source::view},
+    {"state/string", letters, [run](state::State<> &s) { return run->parse(s); }, Source::string},
+    {"state/istream", letters, [run](state::State<> &s) { return run->parse(s); }, Source::istream, 1 << 20},
+    {"calc", [](std::mt19937 &rng) { return expression(rng, 6) + "\n"; }, [sums](state::State<> &s) { return (uint64_t)sums->parse(s); }},
+    {"identifier lists", [](std::mt19937 &rng) {
+      std::string str = "[" + word(rng);
+      for (size_t k = rng() % 8; k > 0; k--) str += ", " + word(rng);
+      return str + "]\n";
+    }, [lists](state::State<> &s) { return lists->parse(s); }},
+  };
+}
+
+/*! Time one call per document, returns the histogram of nanoseconds per document */
+template <typename F>
+static profile::Histogram per_document(const std::vector<std::string> &docs, F &&parse_one)
+{
+  profile::Histogram h;
+  for (const std::string &doc : docs)
+  {
+    const clk::time_point t0 = clk::now();
+    parse_one(doc);
+    h.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clk::now() - t0).count());
+  }
+  return h;
+}
+
+/*! Per-document latency of the end to end grammars across states and execution modes */
+static void latency(size_t n)
+{
+  std::mt19937 rng(7);
+  std::vector<std::string> exprs, lists;
+  for (size_t k = 0; k < n; k++)
+  {
+    std::string e = expression(rng, 6);
+    e.erase(std::remove(e.begin(), e.end(), ' '), e.end());
+    exprs.push_back(e);
+    std::string l = "[" + word(rng);
+    for (size_t j = rng() % 8; j > 0; j--) l += ", " + word(rng);
+    lists.push_back(l + "]");
+  }
+  const Parser<int> *expr = calc();
+  const Parser<std::string_view> *list = between(symbol("["), identifier->keep_left(symbol(",")->keep_right(identifier)->skip_many()), symbol("]"));
+  const Validator<std::string_view> check(list);
+  std::printf("\n%-28s latency ns per document, %zu documents\n", "grammar/mode/state", n);
+  auto row = [](const char *name, const profile::Histogram &h) { std::printf("%-28s %s\n", name, h.summary().c_str()); };
+  row("calc/parse/view", per_document(exprs, [&](const std::string &d) {
+    state::StateView<> s(d);
+    expr->parse(s);
+  }));
+  row("calc/parse/string", per_document(exprs, [&](const std::string &d) {
+    std::string str = d;
+    state::StateString<> s(&str);
+    expr->parse(s);
+  }));
+  row("calc/parse/istream", per_document(exprs, [&](const std::string &d) {
+    std::istringstream in(d);
+    state::StateIStream<> s(&in);
+    expr->parse(s);
+  }));
+  row("lists/parse/view", per_document(lists, [&](const std::string &d) { list->parse(d); }));
+  row("lists/validate/view", per_document(lists, [&](const std::string &d) { check.check(d); }));
+}
+
+/*! Parse input from the case's source, returns checksum and flags whether all input was consumed */
+static uint64_t once(const Case &c, std::string &input, bool &complete)
+{
+  uint64_t sum = 0;
+  if (c.source == Source::istream)
+  {
+    std::istringstream in(input);
+    state::StateIStream<> s(&in);
+    sum = c.run(s);
+    complete = (size_t)s.get_pos() == input.size();
+  }
+  else if (c.source == Source::string)
+  {
+    state::StateString<> s(&input);
+    sum = c.run(s);
+    complete = (size_t)s.get_pos() == input.size();
+  }
+  else
+  {
+    state::StateView<> s(input);
+    sum = c.run(s);
+    complete = (size_t)s.get_pos() == input.size();
+  }
+  return sum;
+}
+
+/*! Sink for checksums so the parses are not optimized away */
+static volatile uint64_t checksum;
+
+int main(int argc, char **argv)
+{
+  const size_t max_mb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 32;
+  const double min_seconds = 0.2;
+  std::setvbuf(stdout, nullptr, _IONBF, 0);
+  PerfCounters perf;
+  if (!perf.reason().empty()) std::printf("hardware counters %s: %s\n", perf.any() ? "partly unavailable" : "unavailable", perf.reason().c_str());
+  std::printf("%-18s %12s %10s %10s %12s", "case", "bytes", "MB/s", "ns/byte", "allocs/byte");
+  for (const char *name : PerfCounters::names) std::printf(" %10s", (std::string(name) + "/B").c_str());
+  std::printf("\n");
+  int status = 0;
+  for (const Case &c : cases())
+  {
+    for (size_t n = 1 << 10; n <= max_mb << 20 && n <= c.max; n <<= 5)
+    {
+      std::mt19937 rng(42);
+      std::string input;
+      input.reserve(n + 256);
+      while (input.size() < n) input += c.unit(rng);
+      uint64_t sum = 0, runs = 0;
+      bool complete = true;
+      const alloc::Scope allocs;
+      perf.start();
+      const clk::time_point t0 = clk::now();
+      double secs = 0;
+      while (secs < min_seconds || runs == 0)
+      {
+        sum += once(c, input, complete);
+        runs++;
+        secs = std::chrono::duration<double>(clk::now() - t0).count();
+      }
+      perf.stop();
+      const double bytes = (double)input.size() * runs;
+      std::printf("%-18s %12zu %10.2f %10.3f %12.5f", c.name.c_str(), input.size(), bytes / secs / 1e6,
+        secs * 1e9 / bytes, allocs.allocations() / bytes);
+      for (int k = 0; k < PerfCounters::count; k++)
+        if (perf.value(k) < 0)
+          std::printf(" %10s", "-");
+        else
+          std::printf(" %10.4f", perf.value(k) / bytes);
+      std::printf("%s\n", complete ? "" : "  (incomplete parse)");
+      if (!complete) status = 1;
+      checksum = sum;
+    }
+  }
+  latency(20000);
+  return status;
+}
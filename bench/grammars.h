@@ -0,0 +1,66 @@
+#pragma once
+#include "parser_combinator.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/*! Random lower case word of 1 to 12 letters */
+inline std::string word(std::mt19937 &rng)
+{
+  std::string str(1 + rng() % 12, ' ');
+  for (char &c : str) c = 'a' + rng() % 26;
+  return str;
+}
+
+/*! Random arithmetic expression, divisors are non zero literals */
+inline std::string expression(std::mt19937 &rng, int depth)
+{
+  if (depth == 0 || rng() % 3 == 0) return std::to_string(rng() % 1000);
+  static const char ops[] = "+-*/";
+  const char op = ops[rng() % 4];
+  const std::string rhs = op == '/' ? std::to_string(1 + rng() % 9) : expression(rng, depth - 1);
+  const std::string str = expression(rng, depth - 1) + " " + op + " " + rhs;
+  return rng() % 2 ? "(" + str + ")" : str;
+}
+
+/*!
+ * Apply a calculator operator, arithmetic wraps around
+ * @param x left operand
+ * @param op 0 to 3 for + - * and /
+ * @param y right operand
+ * @return result
+ */
+inline int calc_apply(int x, size_t op, int y)
+{
+  switch (op)
+  {
+  case 0: return (int)((unsigned)x + (unsigned)y);
+  case 1: return (int)((unsigned)x - (unsigned)y);
+  case 2: return (int)((unsigned)x * (unsigned)y);
+  default: return y == 0 ? 0 : x / y;
+  }
+}
+
+/*!
+ * Calculator grammar of src/examples/calc.bak: expressions over + - * / with the usual
+ * precedence, left associativity and parentheses, arithmetic wraps around
+ */
+inline const parser::Parser<int> *calc()
+{
+  using namespace parser;
+  using namespace parser::parsers;
+  Rule<int> *expr = rule<int>("expr");
+  const Parser<int> *term = between(symbol("("), expr, symbol(")"))->alt(integer)->map<int>(alg::util::get_either<int>);
+  auto chain = [](const Parser<int> *operand, std::vector<std::string> ops, size_t base) {
+    return operand
+      ->seq(token(one_of_literals(ops))->seq(operand)->many())
+      ->template map<int>([base](auto res) {
+        int x = res.lx;
+        for (const auto &t : res.rx) x = calc_apply(x, base + t.lx.lx, t.rx);
+        return x;
+      });
+  };
+  const Parser<int> *factor = chain(term, {"*", "/"}, 2);
+  expr->define(chain(factor, {"+", "-"}, 0));
+  return expr;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*!
+ * Hardware counters of the calling thread read through perf_event_open.
+ * Each counter is opened on its own so one the kernel or hypervisor refuses does not
+ * take the others with it, unavailable counters read as negative.
+ * Values are scaled by enabled over running time when the kernel multiplexes them.
+ */
+class PerfCounters
+{
+public:
+  static constexpr int count = 5; //!< number of counters
+  static constexpr const char *names[count] = {"cycles", "instr", "br-miss", "L1d-miss", "LLC-miss"};
+
+private:
+  int fds[count];       //!< file descriptor per counter, -1 when unavailable
+  double values[count]; //!< value of the last measurement
+  std::string why;      //!< reason the first counter could not be opened
+
+public:
+  PerfCounters()
+  {
+#ifdef __linux__
+    const uint32_t types[count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    const uint64_t configs[count] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_CACHE_MISSES};
+    for (int k = 0; k < count; k++)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = types[k];
+      attr.config = configs[k];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[k] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+      if (fds[k] < 0 && why.empty()) why = std::strerror(errno);
+      values[k] = -1;
+    }
+#else
+    for (int k = 0; k < count; k++)
+    {
+      fds[k] = -1;
+      values[k] = -1;
+    }
+    why = "perf_event_open needs Linux";
+#endif
+  }
+  PerfCounters(const PerfCounters &) = delete;
+  ~PerfCounters()
+  {
+#ifdef __linux__
+    for (int fd : fds)
+      if (fd >= 0) close(fd);
+#endif
+  }
+
+  /*! Flag whether any counter could be opened */
+  bool any() const
+  {
+    for (int fd : fds)
+      if (fd >= 0) return true;
+    return false;
+  }
+  /*! Reason the first unavailable counter could not be opened, empty when all opened */
+  const std::string &reason() const { return why; }
+
+  /*! Zero and start every available counter */
+  void start()
+  {
+#ifdef __linux__
+    for (int fd : fds)
+      if (fd >= 0)
+      {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+  }
+  /*! Stop every available counter and read its value */
+  void stop()
+  {
+#ifdef __linux__
+    for (int k = 0; k < count; k++)
+    {
+      values[k] = -1;
+      if (fds[k] < 0) continue;
+      ioctl(fds[k], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t buf[3];
+      if (read(fds[k], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+      values[k] = (double)buf[0] * ((double)buf[1] / (double)buf[2]);
+    }
+#endif
+  }
+  /*!
+   * Value of a counter in the last measurement
+   * @param k counter index
+   * @return count, negative when unavailable
+   */
+  double value(int k) const { return values[k]; }
+};
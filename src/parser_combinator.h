@@ -1,6 +1,39 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <istream>
+#include <ostream>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <cstdint>
+#include <bitset>
+#include <map>
+#include <deque>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PARSER_SCAN_X86
+#include <immintrin.h>
+#endif
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
 
 // algebraic data structures
 ///////////////////////////////////////////////////////////////////////////////
@@ -108,6 +141,12 @@ namespace parser::alg::util
 namespace parser::state {
   static const std::string STATE_NOT_FAILED_LABEL = "<not failed>"; //!< label when state not in failure state
   struct empty {}; //!< empty struct for default user data in state
+  /*! Error skipped over by a recovering parser */
+  struct Error
+  {
+    int pos;              //!< farthest index reached before failing
+    std::string expected; //!< labels of the parsers that failed there, empty when none was labelled
+  };
   /*! State object virtual class */
   template <typename X = empty>
   class State {
@@ -116,12 +155,16 @@ namespace parser::state {
   private:
     bool failed;                //!< flag to determine failure
     std::string failure_label;  //!< label for parser failures
+    int far;                    //!< farthest index a labelled parser failed at, -1 before any failure
+    std::vector<std::string_view> expected; //!< labels of the parsers that failed at far
+    std::vector<Error> errors;  //!< errors recovered from, in input order
+    std::shared_ptr<std::deque<std::string>> kept; //!< copies of slices of non contiguous sources
   public:
     X data;                     //!< user data
     /*!
      * Construct state with pointer to source string
      */
-    State() : i(0), failed(false) {}
+    State() : i(0), failed(false), far(-1) {}
     /*!
      * Advance the currently consumed character (must be implemented by inheriting class)
      * @return consumed character
@@ -129,6 +172,21 @@ namespace parser::state {
     virtual const char adv() {
       throw std::vector<State<X>>();
     }
+    /*!
+     * Look at the currently to be consumed character without consuming it
+     * @return character as unsigned byte, -1 at end of input
+     */
+    virtual const int peek() {
+      const int _i = i;
+      try {
+        const unsigned char c = adv();
+        i = _i;
+        return c;
+      } catch (std::vector<State<X>> &e) {
+        i = _i;
+        return -1;
+      }
+    }
     /*!
      * Set state to failure with accompanying label
      * @param label failure label
@@ -149,6 +207,119 @@ namespace parser::state {
     const std::string& get_fail() {
       return failed ? failure_label : STATE_NOT_FAILED_LABEL;
     }
+    /*!
+     * Record that a labelled parser failed starting at an index, only the farthest index is kept.
+     * Labels are viewed rather than copied, the grammar must outlive the state's report.
+     * @param at index the parser started at
+     * @param label parser label
+     */
+    void expect(const int at, std::string_view label) {
+      if (at < far) return;
+      if (at > far) {
+        far = at;
+        expected.clear();
+      }
+      for (std::string_view l : expected)
+        if (l == label) return;
+      expected.push_back(label);
+    }
+    /*!
+     * Get farthest index a labelled parser failed at
+     * @return index, -1 before any failure
+     */
+    const int get_far() { return far; }
+    /*!
+     * Get labels of the parsers that failed at the farthest index
+     * @return labels
+     */
+    const std::vector<std::string_view>& get_expected() { return expected; }
+    /*!
+     * Join the labels of the parsers that failed at the farthest index
+     * @return labels separated by commas and a final or
+     */
+    std::string expectation() {
+      std::string r;
+      for (size_t k = 0; k < expected.size(); k++) {
+        if (k > 0) r += k + 1 == expected.size() ? " or " : ", ";
+        r += expected[k];
+      }
+      return r;
+    }
+    /*!
+     * Build a human readable report of the farthest failure
+     * @return report
+     */
+    std::string report() {
+      if (far < 0) return "parse failed";
+      return "expected " + expectation() + " at " + std::to_string(far);
+    }
+    /*!
+     * Move the farthest failure record into the error list, used when recovering from a failure
+     * @param from index the failed parse started at, reported when no labelled parser failed after it
+     */
+    void recover_from(const int from) {
+      if (far >= from) errors.push_back(Error{far, expectation()});
+      else errors.push_back(Error{from, ""});
+      far = -1;
+      expected.clear();
+    }
+    /*!
+     * Append an error found elsewhere, such as in a slice parsed on another state
+     * @param e error
+     */
+    void add_error(Error e) { errors.push_back(std::move(e)); }
+    /*!
+     * Get errors recovered from
+     * @return errors in input order
+     */
+    const std::vector<Error>& get_errors() { return errors; }
+    /*!
+     * Forget the failure flag, the farthest failure record and the recovered errors
+     */
+    void clear_failure() {
+      failed = false;
+      failure_label.clear();
+      far = -1;
+      expected.clear();
+      errors.clear();
+    }
+    /*!
+     * Get index of the currently to be consumed character
+     * @return index
+     */
+    const int get_pos() { return i; }
+    /*!
+     * Jump to an index previously returned by get_pos, used for backtracking
+     * @param _i index
+     */
+    void set_pos(const int _i) { i = _i; }
+    /*!
+     * Flag whether the source can be viewed as one contiguous buffer
+     * @return flag
+     */
+    virtual const bool is_contiguous() { return false; }
+    /*!
+     * Get the unconsumed input, only meaningful when is_contiguous holds
+     * @return view of the remaining input
+     */
+    virtual std::string_view rest() { return std::string_view(); }
+    /*!
+     * Get the input between two indices.
+     * Contiguous sources return a view of the source,
+     * others re-read the bytes into a copy kept alive by the state and its copies.
+     * @param from first index
+     * @param to index after the last
+     * @return view of the input
+     */
+    virtual std::string_view slice(const int from, const int to) {
+      const int _i = i;
+      std::string str;
+      for (i = from; i < to;) str += adv();
+      i = _i;
+      if (!kept) kept = std::make_shared<std::deque<std::string>>();
+      kept->push_back(std::move(str));
+      return kept->back();
+    }
   };
 
   /*! State using std::string as source */
@@ -159,9 +330,49 @@ namespace parser::state {
   public:
     StateString(std::string *_src) : State<X>(), src(_src) {}
     const char adv() override {
-      if (this->i >= src->size()) throw std::vector<State<X>>();
+      if ((size_t)this->i >= src->size()) throw std::vector<State<X>>();
       return src->at(this->i++);
     }
+    const int peek() override {
+      return (size_t)this->i < src->size() ? (unsigned char)(*src)[this->i] : -1;
+    }
+    const bool is_contiguous() override { return true; }
+    std::string_view rest() override {
+      return std::string_view(*src).substr(this->i);
+    }
+    std::string_view slice(const int from, const int to) override {
+      return std::string_view(*src).substr(from, to - from);
+    }
+  };
+
+  /*! State using a non owning std::string_view as source */
+  template <typename X = empty>
+  class StateView : public State<X> {
+  private:
+    std::string_view src;       //!< view of source to be parsed
+  public:
+    StateView(std::string_view _src) : State<X>(), src(_src) {}
+    /*!
+     * Point state at a new source so it can be reused across parses
+     * @param _src view of source to be parsed
+     */
+    void reset(std::string_view _src) {
+      src = _src;
+      this->i = 0;
+      this->clear_failure();
+    }
+    const char adv() override {
+      if ((size_t)this->i >= src.size()) throw std::vector<State<X>>();
+      return src[this->i++];
+    }
+    const int peek() override {
+      return (size_t)this->i < src.size() ? (unsigned char)src[this->i] : -1;
+    }
+    const bool is_contiguous() override { return true; }
+    std::string_view rest() override { return src.substr(this->i); }
+    std::string_view slice(const int from, const int to) override {
+      return src.substr(from, to - from);
+    }
   };
 
   /*! State using std::istream as source */
@@ -172,7 +383,8 @@ namespace parser::state {
   public:
     StateIStream(std::istream *_src) : State<X>(), src(_src) {}
     const char adv() override {
-      char c;
+      char c = 0;
+      src->clear();
       if (this->i != src->tellg()) src->seekg(this->i);
       *src >> c;
       if (c == 0) throw std::vector<State<X>>();
@@ -182,3 +394,2924 @@ namespace parser::state {
   };
 }
 
+
+// scheduler
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::sched
+{
+  /*!
+   * Fork/join pool for independent tasks.
+   * Every worker owns a range of task indices which it consumes from the front,
+   * idle workers steal the upper half of another worker's range.
+   * Ranges are packed into one atomic word so neither popping nor stealing locks,
+   * the mutex only guards waking the workers at the start and end of a run.
+   */
+  class Pool
+  {
+  private:
+    using Job = std::function<void(size_t, size_t)>;
+    /*! Half open range of task indices owned by a worker, padded to a cache line */
+    struct alignas(64) Range
+    {
+      std::atomic<uint64_t> r{0}; //!< begin in the high word, end in the low word
+    };
+    std::unique_ptr<Range[]> ranges;     //!< one range per worker
+    std::vector<std::thread> threads;    //!< workers other than the calling thread
+    std::mutex m;                        //!< guards job publication
+    std::mutex run_m;                    //!< serialises concurrent runs
+    std::condition_variable cv_start;    //!< signals a new job
+    std::condition_variable cv_done;     //!< signals all workers finished a job
+    const Job *job = nullptr;            //!< job of current run
+    size_t generation = 0;               //!< number of published jobs
+    size_t active = 0;                   //!< workers still busy with current job
+    bool stop = false;                   //!< flag to shut workers down
+
+    static uint64_t pack(uint64_t b, uint64_t e) { return (b << 32) | e; }
+    static bool &in_worker()
+    {
+      static thread_local bool flag = false;
+      return flag;
+    }
+    bool pop(size_t w, size_t &t)
+    {
+      uint64_t r = ranges[w].r.load(std::memory_order_acquire);
+      while ((r >> 32) < (r & 0xffffffff))
+      {
+        if (ranges[w].r.compare_exchange_weak(r, pack((r >> 32) + 1, r & 0xffffffff)))
+        {
+          t = r >> 32;
+          return true;
+        }
+      }
+      return false;
+    }
+    bool steal(size_t w)
+    {
+      const size_t n = threads.size() + 1;
+      for (size_t k = 1; k < n; k++)
+      {
+        Range &v = ranges[(w + k) % n];
+        uint64_t r = v.r.load(std::memory_order_acquire);
+        while ((r >> 32) < (r & 0xffffffff))
+        {
+          const uint64_t b = r >> 32, e = r & 0xffffffff, mid = b + (e - b) / 2;
+          if (v.r.compare_exchange_weak(r, pack(b, mid)))
+          {
+            ranges[w].r.store(pack(mid, e), std::memory_order_release);
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+    void work(size_t w, const Job &fn)
+    {
+      size_t t;
+      do
+        while (pop(w, t)) fn(t, w);
+      while (steal(w));
+    }
+    void loop(size_t w)
+    {
+      in_worker() = true;
+      size_t seen = 0;
+      while (true)
+      {
+        const Job *fn;
+        {
+          std::unique_lock<std::mutex> l(m);
+          cv_start.wait(l, [&] { return stop || generation != seen; });
+          if (stop) return;
+          seen = generation;
+          fn = job;
+        }
+        work(w, *fn);
+        std::lock_guard<std::mutex> l(m);
+        if (--active == 0) cv_done.notify_all();
+      }
+    }
+
+  public:
+    /*!
+     * Construct pool, the thread calling run counts as one of the workers
+     * @param workers number of workers
+     */
+    Pool(size_t workers) : ranges(new Range[workers ? workers : 1])
+    {
+      for (size_t w = 1; w < workers; w++)
+        threads.emplace_back([this, w] { loop(w); });
+    }
+    ~Pool()
+    {
+      {
+        std::lock_guard<std::mutex> l(m);
+        stop = true;
+      }
+      cv_start.notify_all();
+      for (std::thread &t : threads) t.join();
+    }
+    /*!
+     * Get number of workers
+     * @return number of workers
+     */
+    const size_t size() { return threads.size() + 1; }
+    /*!
+     * Run tasks 0 to n - 1 and return once all are done.
+     * Runs inline when called from within a worker so nested runs cannot deadlock.
+     * @param n number of tasks
+     * @param fn task taking the task index and worker index, must not throw
+     */
+    void run(size_t n, const Job &fn)
+    {
+      if (n == 0) return;
+      if (threads.empty() || in_worker())
+      {
+        for (size_t t = 0; t < n; t++) fn(t, 0);
+        return;
+      }
+      std::lock_guard<std::mutex> r(run_m);
+      const size_t w = size();
+      for (size_t k = 0; k < w; k++)
+        ranges[k].r.store(pack(n * k / w, n * (k + 1) / w), std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> l(m);
+        job = &fn;
+        active = threads.size();
+        generation++;
+      }
+      cv_start.notify_all();
+      in_worker() = true;
+      work(0, fn);
+      in_worker() = false;
+      std::unique_lock<std::mutex> l(m);
+      cv_done.wait(l, [&] { return active == 0; });
+      job = nullptr;
+    }
+    /*!
+     * Get process wide pool sized to the hardware concurrency
+     * @return shared pool
+     */
+    static Pool &shared()
+    {
+      static Pool pool(std::thread::hardware_concurrency());
+      return pool;
+    }
+  };
+}
+
+// character classes
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::chars
+{
+  /*! Set of bytes as a 256 bit map, composable in constant expressions */
+  class CharClass
+  {
+  private:
+    uint64_t w[4]; //!< membership, byte c is bit c % 64 of word c / 64
+    constexpr CharClass(uint64_t a, uint64_t b, uint64_t c, uint64_t d) : w{a, b, c, d} {}
+
+  public:
+    /*! Construct empty class */
+    constexpr CharClass() : w{0, 0, 0, 0} {}
+    /*!
+     * Class of an inclusive range of bytes
+     * @param a first byte
+     * @param b last byte
+     */
+    static constexpr CharClass range(unsigned char a, unsigned char b)
+    {
+      CharClass r;
+      for (int c = a; c <= b; c++) r.w[c >> 6] |= uint64_t(1) << (c & 63);
+      return r;
+    }
+    /*! Class of one byte */
+    static constexpr CharClass of(char c) { return range(c, c); }
+    /*! Class of every byte in a string */
+    static constexpr CharClass of(const char *cs)
+    {
+      CharClass r;
+      for (; *cs; cs++) r = r | of(*cs);
+      return r;
+    }
+    /*! Class of every byte satisfying a predicate, evaluated once per byte */
+    static CharClass of(const std::function<bool(char)> &pred)
+    {
+      CharClass r;
+      for (int c = 0; c < 256; c++)
+        if (pred((char)c)) r.w[c >> 6] |= uint64_t(1) << (c & 63);
+      return r;
+    }
+    /*!
+     * Class from a <cctype> classification function under the current C locale,
+     * the only locale dependent way to build a class
+     * @param is classification function such as std::isalpha
+     */
+    static CharClass locale(int (*is)(int))
+    {
+      return of([is](char c) { return is((unsigned char)c) != 0; });
+    }
+    /*! Union */
+    constexpr CharClass operator|(const CharClass &o) const { return CharClass(w[0] | o.w[0], w[1] | o.w[1], w[2] | o.w[2], w[3] | o.w[3]); }
+    /*! Intersection */
+    constexpr CharClass operator&(const CharClass &o) const { return CharClass(w[0] & o.w[0], w[1] & o.w[1], w[2] & o.w[2], w[3] & o.w[3]); }
+    /*! Complement */
+    constexpr CharClass operator~() const { return CharClass(~w[0], ~w[1], ~w[2], ~w[3]); }
+    /*! Difference */
+    constexpr CharClass operator-(const CharClass &o) const { return *this & ~o; }
+    constexpr bool operator==(const CharClass &o) const { return w[0] == o.w[0] && w[1] == o.w[1] && w[2] == o.w[2] && w[3] == o.w[3]; }
+    constexpr bool operator!=(const CharClass &o) const { return !(*this == o); }
+    /*!
+     * Test membership
+     * @param c byte
+     * @return flag
+     */
+    constexpr bool has(char c) const
+    {
+      const unsigned char u = c;
+      return (w[u >> 6] >> (u & 63)) & 1;
+    }
+    /*! Membership as a bitset */
+    std::bitset<256> bits() const
+    {
+      std::bitset<256> r;
+      for (int c = 0; c < 256; c++) r[c] = has((char)c);
+      return r;
+    }
+  };
+
+  inline constexpr CharClass digit = CharClass::range('0', '9');
+  inline constexpr CharClass lower = CharClass::range('a', 'z');
+  inline constexpr CharClass upper = CharClass::range('A', 'Z');
+  inline constexpr CharClass letter = lower | upper;
+  inline constexpr CharClass alphanum = letter | digit;
+  inline constexpr CharClass space = CharClass::of(" \t\n\v\f\r");
+  inline constexpr CharClass hex = digit | CharClass::range('a', 'f') | CharClass::range('A', 'F');
+}
+
+// span scanning
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::scan
+{
+  /*!
+   * Byte class prepared for finding the end of a run of member bytes.
+   * Holds a lookup table for the scalar path, up to four ranges for the SSE2 path
+   * and nibble tables for the AVX2 path which handles any class.
+   */
+  struct Class
+  {
+    uint8_t table[256];   //!< membership per byte
+    uint8_t lo_rows[16];  //!< bit h set when byte (h << 4 | index) is a member, h < 8
+    uint8_t hi_rows[16];  //!< bit h - 8 set when byte (h << 4 | index) is a member, h >= 8
+    uint8_t from[4];      //!< first byte of each range
+    uint8_t width[4];     //!< last minus first byte of each range
+    int ranges;           //!< number of ranges, -1 when more than four
+
+    /*!
+     * Construct class from a byte set
+     * @param set member bytes
+     */
+    Class(const std::bitset<256> &set) : lo_rows(), hi_rows(), ranges(0)
+    {
+      for (int c = 0; c < 256; c++)
+      {
+        table[c] = set[c];
+        if (set[c]) (c < 128 ? lo_rows : hi_rows)[c & 15] |= 1 << ((c >> 4) & 7);
+      }
+      for (int c = 0; c < 256 && ranges >= 0;)
+      {
+        if (!set[c])
+        {
+          c++;
+          continue;
+        }
+        int e = c;
+        while (e < 255 && set[e + 1]) e++;
+        if (ranges == 4)
+          ranges = -1;
+        else
+        {
+          from[ranges] = c;
+          width[ranges] = e - c;
+          ranges++;
+        }
+        c = e + 1;
+      }
+    }
+  };
+
+#ifdef PARSER_SCAN_X86
+  /*! Index of the first non member within the whole 16 byte blocks of src, or where blocks end */
+  inline size_t span_sse2(const Class &c, const char *src, size_t n)
+  {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+      const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i in = _mm_setzero_si128();
+      for (int r = 0; r < c.ranges; r++)
+      {
+        const __m128i w = _mm_set1_epi8((char)c.width[r]);
+        const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8((char)c.from[r]));
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(_mm_max_epu8(t, w), w));
+      }
+      const unsigned out = ~(unsigned)_mm_movemask_epi8(in) & 0xffff;
+      if (out) return i + __builtin_ctz(out);
+    }
+    return i;
+  }
+
+  /*! Index of the first non member within the whole 32 byte blocks of src, or where blocks end */
+  __attribute__((target("avx2"))) inline size_t span_avx2(const Class &c, const char *src, size_t n)
+  {
+    const __m256i lo_rows = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)c.lo_rows));
+    const __m256i hi_rows = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)c.hi_rows));
+    const __m256i bits = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+      const __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+      const __m256i lo = _mm256_and_si256(v, nibble);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+      const __m256i row = _mm256_blendv_epi8(
+        _mm256_shuffle_epi8(lo_rows, lo), _mm256_shuffle_epi8(hi_rows, lo),
+        _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(7)));
+      const __m256i bit = _mm256_shuffle_epi8(bits, hi);
+      const __m256i in = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+      const unsigned out = ~(unsigned)_mm256_movemask_epi8(in);
+      if (out) return i + __builtin_ctz(out);
+    }
+    return i;
+  }
+
+  /*! Flag whether the running cpu supports AVX2 */
+  inline bool has_avx2()
+  {
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+  }
+#endif
+
+  /*!
+   * Length of the longest prefix of src made of class members.
+   * Uses AVX2 when the cpu has it, SSE2 for classes of up to four ranges,
+   * and a table lookup for the rest.
+   * @param c class
+   * @param src start of input
+   * @param n length of input
+   * @return prefix length
+   */
+  inline size_t span(const Class &c, const char *src, size_t n)
+  {
+    size_t i = 0;
+#ifdef PARSER_SCAN_X86
+    if (has_avx2())
+      i = span_avx2(c, src, n);
+    else if (c.ranges >= 0)
+      i = span_sse2(c, src, n);
+#endif
+    while (i < n && c.table[(unsigned char)src[i]]) i++;
+    return i;
+  }
+
+#if (defined(__GNUC__) || defined(__clang__)) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PARSER_SCAN_SWAR
+  /*! Flag whether all eight bytes of a little endian word are decimal digits */
+  inline bool is_eight_digits(uint64_t w)
+  {
+    return ((w & 0xf0f0f0f0f0f0f0f0) | (((w + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4)) == 0x3333333333333333;
+  }
+  /*! Value of eight decimal digits held in a little endian word */
+  inline uint64_t eight_digits(uint64_t w)
+  {
+    w -= 0x3030303030303030;
+    w = (w * 10) + (w >> 8);
+    return (((w & 0x000000ff000000ff) * 0x000f424000000064) + (((w >> 16) & 0x000000ff000000ff) * 0x0000271000000001)) >> 32;
+  }
+#endif
+
+  /*!
+   * Accumulate a run of decimal digits, eight at a time where the compiler allows
+   * @param src start of input
+   * @param n length of input
+   * @param v accumulated value
+   * @param overflow set when the value does not fit 64 bits, reading stops there
+   * @return number of digits read
+   */
+  inline size_t decimal(const char *src, size_t n, uint64_t &v, bool &overflow)
+  {
+    size_t i = 0;
+    v = 0;
+    overflow = false;
+#ifdef PARSER_SCAN_SWAR
+    for (uint64_t w; i + 8 <= n; i += 8)
+    {
+      std::memcpy(&w, src + i, 8);
+      if (!is_eight_digits(w)) break;
+      if (__builtin_mul_overflow(v, (uint64_t)100000000, &v) || __builtin_add_overflow(v, eight_digits(w), &v))
+      {
+        overflow = true;
+        return i;
+      }
+    }
+#endif
+    for (; i < n && (unsigned char)(src[i] - '0') < 10; i++)
+    {
+      const uint64_t d = src[i] - '0';
+      if (v > (std::numeric_limits<uint64_t>::max() - d) / 10)
+      {
+        overflow = true;
+        return i;
+      }
+      v = v * 10 + d;
+    }
+    return i;
+  }
+}
+
+// bytecode vm
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::vm
+{
+  struct Node;
+  using Pat = std::shared_ptr<const Node>; //!< pattern tree, null when a parser cannot be lowered
+
+  /*! Node of a recognizer pattern tree, the combinators lower to these */
+  struct Node
+  {
+    enum Kind { Empty, Set, Literal, Seq, Choice, Star, Capture, Ref, Native } kind; //!< node kind
+    std::bitset<256> set; //!< bytes matched by a Set
+    std::string str;      //!< text of a Literal, rule name of a Ref
+    Pat a;                //!< first operand
+    Pat b;                //!< second operand
+    std::function<size_t(std::string_view)> fn; //!< matcher of a Native
+    std::shared_ptr<Pat> def; //!< body of a Ref bound to a rule, null until the rule is defined
+  };
+
+  /*! Pattern matching the empty string */
+  inline Pat empty() { return std::make_shared<const Node>(Node{Node::Empty}); }
+  /*! Pattern matching one byte in a set */
+  inline Pat set(const std::bitset<256> &bs) { return std::make_shared<const Node>(Node{Node::Set, bs}); }
+  /*! Pattern matching a literal string */
+  inline Pat lit(const std::string &str) { return std::make_shared<const Node>(Node{Node::Literal, {}, str}); }
+  /*! Pattern matching a then b, null if either is */
+  inline Pat seq(const Pat &a, const Pat &b) { return a && b ? std::make_shared<const Node>(Node{Node::Seq, {}, "", a, b}) : nullptr; }
+  /*! Ordered choice of a then b, null if either is */
+  inline Pat choice(const Pat &a, const Pat &b) { return a && b ? std::make_shared<const Node>(Node{Node::Choice, {}, "", a, b}) : nullptr; }
+  /*! Greedy repetition of a, stops when a fails or stops consuming */
+  inline Pat star(const Pat &a) { return a ? std::make_shared<const Node>(Node{Node::Star, {}, "", a}) : nullptr; }
+  /*! Pattern recording the span a matches */
+  inline Pat capture(const Pat &a) { return a ? std::make_shared<const Node>(Node{Node::Capture, {}, "", a}) : nullptr; }
+  /*!
+   * Call of a named rule of the grammar, allows recursion
+   * @param name rule name, looked up in the rules passed to compile
+   * @param def body the call falls back to when the name is not among those rules
+   */
+  inline Pat ref(const std::string &name, std::shared_ptr<Pat> def = nullptr)
+  {
+    return std::make_shared<const Node>(Node{Node::Ref, {}, name, nullptr, nullptr, nullptr, std::move(def)});
+  }
+  /*!
+   * Pattern matching what a native function accepts, for primitives whose acceptance
+   * is not regular such as range checked numbers
+   * @param fn returns the length it matches at the start of the rest of the input, SIZE_MAX to fail
+   */
+  inline Pat native(std::function<size_t(std::string_view)> fn)
+  {
+    return std::make_shared<const Node>(Node{Node::Native, {}, "", nullptr, nullptr, std::move(fn)});
+  }
+
+  /*! Bytecode operations */
+  enum class Op : uint8_t { Char, Set, Span, Lit, Choice, Commit, PartialCommit, Jump, Call, Ret, Fail, OpenCap, CloseCap, Native, End };
+
+  /*! Bytecode instruction */
+  struct Inst
+  {
+    Op op;       //!< operation
+    int32_t arg; //!< byte, set, class or literal index, or jump target
+  };
+
+  /*! Compiled recognizer */
+  struct Program
+  {
+    std::vector<Inst> code;               //!< instructions, entry at 0
+    std::vector<std::bitset<256>> sets;   //!< byte sets referenced by Set
+    std::vector<scan::Class> classes;     //!< byte classes referenced by Span
+    std::vector<std::string> literals;    //!< strings referenced by Lit
+    std::vector<std::function<size_t(std::string_view)>> natives; //!< matchers referenced by Native
+  };
+
+  /*! Result of running a program */
+  struct Match
+  {
+    bool ok = false;                       //!< flag to indicate the pattern matched
+    size_t end = 0;                        //!< index after the matched prefix
+    std::vector<std::string_view> caps;    //!< captured spans in order of opening
+    size_t far = 0;                        //!< farthest index a byte test failed at
+  };
+
+  /*!
+   * Compile a pattern into bytecode, every rule reachable through a Ref
+   * becomes a subroutine, compiled once per body. Left recursive rules never terminate.
+   * @param start pattern matched from the entry point
+   * @param rules named rules
+   * @param captures flag to emit captures, without them a run never allocates for spans
+   * @return program
+   */
+  inline Program compile(const Pat &start, const std::map<std::string, Pat> &rules = {}, bool captures = true)
+  {
+    if (!start) throw std::invalid_argument("pattern cannot be lowered to bytecode");
+    Program prog;
+    std::map<const Node *, int32_t> addr;
+    std::vector<std::pair<size_t, const Node *>> calls;
+    auto at = [&] { return (int32_t)prog.code.size(); };
+    auto put = [&](Op op, int32_t arg = 0) { prog.code.push_back(Inst{op, arg}); return prog.code.size() - 1; };
+    std::function<void(const Node &)> emit = [&](const Node &n) {
+      switch (n.kind)
+      {
+      case Node::Empty:
+        break;
+      case Node::Set:
+        if (n.set.count() == 1)
+        {
+          int c = 0;
+          while (!n.set[c]) c++;
+          put(Op::Char, c);
+        }
+        else
+        {
+          prog.sets.push_back(n.set);
+          put(Op::Set, prog.sets.size() - 1);
+        }
+        break;
+      case Node::Literal:
+        if (n.str.size() == 1)
+          put(Op::Char, (unsigned char)n.str[0]);
+        else if (!n.str.empty())
+        {
+          prog.literals.push_back(n.str);
+          put(Op::Lit, prog.literals.size() - 1);
+        }
+        break;
+      case Node::Seq:
+        emit(*n.a);
+        emit(*n.b);
+        break;
+      case Node::Choice:
+      {
+        const size_t choice = put(Op::Choice);
+        emit(*n.a);
+        const size_t commit = put(Op::Commit);
+        prog.code[choice].arg = at();
+        emit(*n.b);
+        prog.code[commit].arg = at();
+        break;
+      }
+      case Node::Star:
+      {
+        if (n.a->kind == Node::Set)
+        {
+          prog.classes.emplace_back(n.a->set);
+          put(Op::Span, prog.classes.size() - 1);
+          break;
+        }
+        const size_t choice = put(Op::Choice);
+        const int32_t body = at();
+        emit(*n.a);
+        put(Op::PartialCommit, body);
+        prog.code[choice].arg = at();
+        break;
+      }
+      case Node::Capture:
+        if (captures) put(Op::OpenCap);
+        emit(*n.a);
+        if (captures) put(Op::CloseCap);
+        break;
+      case Node::Ref:
+        calls.emplace_back(put(Op::Call), &n);
+        break;
+      case Node::Native:
+        prog.natives.push_back(n.fn);
+        put(Op::Native, prog.natives.size() - 1);
+        break;
+      }
+    };
+    emit(*start);
+    put(Op::End);
+    for (size_t k = 0; k < calls.size(); k++)
+    {
+      const Node &call = *calls[k].second;
+      auto r = rules.find(call.str);
+      const Node *body = r != rules.end() ? r->second.get() : call.def ? call.def->get() : nullptr;
+      if (!body) throw std::invalid_argument("undefined rule " + call.str);
+      if (!addr.count(body))
+      {
+        addr[body] = at();
+        emit(*body);
+        put(Op::Ret);
+      }
+      prog.code[calls[k].first].arg = addr[body];
+    }
+    return prog;
+  }
+
+  /*! Stack keeping its first N entries inline, spilling to the heap only for deep nesting */
+  template <typename E, size_t N>
+  class SmallStack
+  {
+  private:
+    E small[N];          //!< inline entries
+    std::vector<E> big;  //!< heap entries once more than N are live
+    E *base = small;     //!< current storage
+    size_t top = 0;      //!< number of live entries
+    size_t cap = N;      //!< capacity of current storage
+
+  public:
+    SmallStack() {}
+    SmallStack(const SmallStack &) = delete;
+    bool empty() const { return top == 0; }
+    E &back() { return base[top - 1]; }
+    void pop_back() { top--; }
+    void push_back(const E &e)
+    {
+      if (top == cap)
+      {
+        big.resize(cap * 2);
+        if (base == small) std::copy(small, small + top, big.begin());
+        base = big.data();
+        cap *= 2;
+      }
+      base[top++] = e;
+    }
+  };
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PARSER_VM_COMPUTED_GOTO
+#endif
+
+  /*!
+   * Match a program against the start of a source.
+   * Backtrack entries and call frames share one explicit stack, held inline while shallow
+   * and on the heap beyond that, so nesting depth is bounded by memory rather than the native stack.
+   * Dispatch uses computed goto where the compiler supports it.
+   * @param prog program
+   * @param src source
+   * @return match
+   */
+  inline Match run(const Program &prog, std::string_view src)
+  {
+    struct Entry
+    {
+      size_t addr; //!< alternative or return address
+      size_t pos;  //!< position to restore, SIZE_MAX for a call frame
+      size_t caps; //!< capture events to keep
+    };
+    SmallStack<Entry, 32> stack;
+    std::vector<std::pair<size_t, bool>> caps;
+    const Inst *code = prog.code.data();
+    const unsigned char *s = (const unsigned char *)src.data();
+    const size_t n = src.size();
+    size_t pc = 0, pos = 0, far = 0;
+    auto backtrack = [&]() -> bool {
+      while (!stack.empty())
+      {
+        const Entry e = stack.back();
+        stack.pop_back();
+        if (e.pos == SIZE_MAX) continue;
+        pc = e.addr;
+        pos = e.pos;
+        caps.resize(e.caps);
+        return true;
+      }
+      return false;
+    };
+#ifdef PARSER_VM_COMPUTED_GOTO
+    static const void *const labels[] = {
+      &&op_Char, &&op_Set, &&op_Span, &&op_Lit, &&op_Choice, &&op_Commit, &&op_PartialCommit,
+      &&op_Jump, &&op_Call, &&op_Ret, &&op_Fail, &&op_OpenCap, &&op_CloseCap, &&op_Native, &&op_End};
+#define VM_NEXT goto *labels[(int)code[pc].op]
+#define VM_OP(o) op_##o:
+    VM_NEXT;
+#else
+#define VM_NEXT continue
+#define VM_OP(o) case Op::o:
+    for (;;) switch (code[pc].op) {
+#endif
+#define VM_FAIL { if (pos > far) far = pos; if (!backtrack()) return Match{false, 0, {}, far}; VM_NEXT; }
+    VM_OP(Char)
+      if (pos < n && s[pos] == code[pc].arg) { pos++; pc++; VM_NEXT; }
+      VM_FAIL
+    VM_OP(Set)
+      if (pos < n && prog.sets[code[pc].arg][s[pos]]) { pos++; pc++; VM_NEXT; }
+      VM_FAIL
+    VM_OP(Span)
+      pos += scan::span(prog.classes[code[pc].arg], src.data() + pos, n - pos);
+      if (pos > far) far = pos;
+      pc++;
+      VM_NEXT;
+    VM_OP(Lit)
+    {
+      const std::string &l = prog.literals[code[pc].arg];
+      if (n - pos >= l.size() && std::memcmp(s + pos, l.data(), l.size()) == 0) { pos += l.size(); pc++; VM_NEXT; }
+      VM_FAIL
+    }
+    VM_OP(Choice)
+      stack.push_back(Entry{(size_t)code[pc].arg, pos, caps.size()});
+      pc++;
+      VM_NEXT;
+    VM_OP(Commit)
+      stack.pop_back();
+      pc = code[pc].arg;
+      VM_NEXT;
+    VM_OP(PartialCommit)
+    {
+      Entry &e = stack.back();
+      if (e.pos == pos)
+      {
+        pc = e.addr;
+        stack.pop_back();
+      }
+      else
+      {
+        e.pos = pos;
+        e.caps = caps.size();
+        pc = code[pc].arg;
+      }
+      VM_NEXT;
+    }
+    VM_OP(Jump)
+      pc = code[pc].arg;
+      VM_NEXT;
+    VM_OP(Call)
+      stack.push_back(Entry{pc + 1, SIZE_MAX, 0});
+      pc = code[pc].arg;
+      VM_NEXT;
+    VM_OP(Ret)
+      pc = stack.back().addr;
+      stack.pop_back();
+      VM_NEXT;
+    VM_OP(Fail)
+      VM_FAIL
+    VM_OP(OpenCap)
+      caps.emplace_back(pos, true);
+      pc++;
+      VM_NEXT;
+    VM_OP(CloseCap)
+      caps.emplace_back(pos, false);
+      pc++;
+      VM_NEXT;
+    VM_OP(Native)
+    {
+      const size_t len = prog.natives[code[pc].arg](src.substr(pos));
+      if (len != SIZE_MAX) { pos += len; pc++; VM_NEXT; }
+      VM_FAIL
+    }
+    VM_OP(End)
+    {
+      Match m;
+      m.ok = true;
+      m.end = pos;
+      m.far = far;
+      std::vector<size_t> open;
+      for (const std::pair<size_t, bool> &c : caps)
+      {
+        if (c.second)
+        {
+          open.push_back(m.caps.size());
+          m.caps.push_back(src.substr(c.first, 0));
+        }
+        else
+        {
+          std::string_view &v = m.caps[open.back()];
+          v = src.substr(v.data() - src.data(), c.first - (v.data() - src.data()));
+          open.pop_back();
+        }
+      }
+      return m;
+    }
+#ifndef PARSER_VM_COMPUTED_GOTO
+    }
+#endif
+#undef VM_FAIL
+#undef VM_OP
+#undef VM_NEXT
+  }
+}
+
+// profiling
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::profile
+{
+  using clock = std::chrono::steady_clock;
+
+  /*! Counters of one labelled parser */
+  struct Stats
+  {
+    uint64_t calls = 0;        //!< invocations
+    uint64_t successes = 0;    //!< invocations that succeeded
+    uint64_t failures = 0;     //!< invocations that failed
+    uint64_t bytes = 0;        //!< bytes consumed by successful invocations
+    uint64_t backtracks = 0;   //!< failed invocations that had consumed input
+    uint64_t inclusive_ns = 0; //!< time including nested labelled parsers, recursion counted once
+    uint64_t exclusive_ns = 0; //!< time excluding nested labelled parsers
+    int depth = 0;             //!< live invocations, used to count recursion once
+
+    /*! Add the counters of another parser with the same label */
+    void add(const Stats &o)
+    {
+      calls += o.calls;
+      successes += o.successes;
+      failures += o.failures;
+      bytes += o.bytes;
+      backtracks += o.backtracks;
+      inclusive_ns += o.inclusive_ns;
+      exclusive_ns += o.exclusive_ns;
+    }
+  };
+
+  /*!
+   * Log-linear histogram of durations in the style of HdrHistogram.
+   * Values below 256 are exact, larger values land in buckets no wider than 1/128 of
+   * their value, so percentiles are within 0.8% over the whole 64 bit range.
+   */
+  class Histogram
+  {
+  private:
+    static constexpr int sub_bits = 7;                    //!< log2 of buckets per power of two
+    std::vector<uint64_t> counts;                         //!< count per bucket, grown on demand
+    uint64_t total = 0;                                   //!< values recorded
+    uint64_t largest = 0;                                 //!< largest value recorded
+
+    /*! Bucket of a value */
+    static size_t index(uint64_t v)
+    {
+      if (v < (uint64_t)2 << sub_bits) return v;
+      int msb = 63;
+      while (!(v >> msb)) msb--;
+      const int shift = msb - sub_bits;
+      return ((size_t)shift << sub_bits) + (v >> shift);
+    }
+    /*! Largest value of a bucket */
+    static uint64_t highest(size_t i)
+    {
+      if (i < (size_t)2 << sub_bits) return i;
+      const int shift = (int)(i >> sub_bits) - 1;
+      return ((i - ((size_t)shift << sub_bits)) << shift) + (((uint64_t)1 << shift) - 1);
+    }
+
+  public:
+    /*!
+     * Record one value
+     * @param v value, usually nanoseconds
+     */
+    void record(uint64_t v)
+    {
+      const size_t i = index(v);
+      if (i >= counts.size()) counts.resize(i + 1);
+      counts[i]++;
+      total++;
+      largest = std::max(largest, v);
+    }
+    /*! Number of values recorded */
+    uint64_t count() const { return total; }
+    /*! Largest value recorded */
+    uint64_t max() const { return largest; }
+    /*!
+     * Value at or below which a given share of the values fall
+     * @param p percentile between 0 and 100
+     * @return highest value of the bucket holding that rank, 0 when empty
+     */
+    uint64_t percentile(double p) const
+    {
+      if (total == 0) return 0;
+      const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100 * total));
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts.size(); i++)
+        if ((seen += counts[i]) >= rank) return std::min(highest(i), largest);
+      return largest;
+    }
+    /*! Add the values of another histogram */
+    void merge(const Histogram &o)
+    {
+      if (o.counts.size() > counts.size()) counts.resize(o.counts.size());
+      for (size_t i = 0; i < o.counts.size(); i++) counts[i] += o.counts[i];
+      total += o.total;
+      largest = std::max(largest, o.largest);
+    }
+    /*! Forget all values */
+    void clear()
+    {
+      counts.clear();
+      total = 0;
+      largest = 0;
+    }
+    /*!
+     * Render the usual latency percentiles
+     * @return "p50 a p90 b p99 c p99.9 d max e"
+     */
+    std::string summary() const
+    {
+      return "p50 " + std::to_string(percentile(50)) + " p90 " + std::to_string(percentile(90)) +
+        " p99 " + std::to_string(percentile(99)) + " p99.9 " + std::to_string(percentile(99.9)) +
+        " max " + std::to_string(largest);
+    }
+  };
+
+  /*! How call stacks of labelled parsers are recorded */
+  enum class Stacks
+  {
+    off,     //!< not recorded
+    exact,   //!< every invocation adds its exclusive nanoseconds to its stack
+    sampled  //!< the running stack gets one count per elapsed period
+  };
+
+  /*!
+   * Per-label profile of the parses run while it is active on a thread.
+   * Only compiled into Parser::parse when PARSER_PROFILE is defined before including this header,
+   * so builds without it pay nothing. Parsers are keyed by the address of their label,
+   * rows merge parsers sharing a label text.
+   * Call stacks of labels can also be recorded for flame graphs, a stack is only
+   * copied out of the live frames when it is charged.
+   */
+  class Profile
+  {
+  public:
+    /*! Live invocation of a labelled parser */
+    struct Frame
+    {
+      const std::string *label; //!< label of the parser
+      Stats *stats;             //!< counters of the parser
+      clock::time_point start;  //!< time of entry
+      uint64_t child_ns;        //!< time spent in nested labelled parsers
+    };
+
+  private:
+    std::unordered_map<const std::string *, Stats> stats; //!< counters by label address, values never move
+    std::vector<Frame> stack;                             //!< live invocations, innermost last
+    Stacks mode = Stacks::off;                            //!< how stacks are recorded
+    uint64_t period_ns = 0;                               //!< sampling period
+    clock::time_point next_sample;                        //!< time the next sample is due
+    std::map<std::vector<const std::string *>, uint64_t> folds; //!< nanoseconds or samples by stack, outermost first
+    Histogram docs;                                       //!< durations of documents
+    bool in_doc = false;                                  //!< flag to indicate a document is being timed
+
+    /*! Add a value to the current stack */
+    void charge(uint64_t v)
+    {
+      std::vector<const std::string *> key(stack.size());
+      for (size_t k = 0; k < stack.size(); k++) key[k] = stack[k].label;
+      folds[key] += v;
+    }
+    /*! Charge the samples due by now to the current stack */
+    void sample(clock::time_point now)
+    {
+      if (now < next_sample) return;
+      const uint64_t n = std::chrono::duration_cast<std::chrono::nanoseconds>(now - next_sample).count() / period_ns + 1;
+      next_sample += std::chrono::nanoseconds(n * period_ns);
+      if (!stack.empty()) charge(n);
+    }
+
+  public:
+    /*!
+     * Choose how call stacks are recorded
+     * @param _mode mode
+     * @param _period_ns sampling period in nanoseconds, used when sampled
+     */
+    void set_stacks(Stacks _mode, uint64_t _period_ns = 100000)
+    {
+      mode = _mode;
+      period_ns = std::max<uint64_t>(_period_ns, 1);
+      next_sample = clock::now() + std::chrono::nanoseconds(period_ns);
+    }
+    /*!
+     * Record entry into a labelled parser
+     * @param label label of the parser
+     */
+    void enter(const std::string &label)
+    {
+      Stats &st = stats[&label];
+      st.calls++;
+      st.depth++;
+      const clock::time_point now = clock::now();
+      if (mode == Stacks::sampled) sample(now);
+      stack.push_back(Frame{&label, &st, now, 0});
+    }
+    /*!
+     * Record exit from the innermost labelled parser
+     * @param ok flag to indicate the parser succeeded
+     * @param consumed bytes between entry and exit
+     */
+    void leave(bool ok, int consumed)
+    {
+      const clock::time_point now = clock::now();
+      const Frame fr = stack.back();
+      const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - fr.start).count();
+      if (mode == Stacks::sampled)
+        sample(now);
+      else if (mode == Stacks::exact)
+        charge(ns - std::min(ns, fr.child_ns));
+      stack.pop_back();
+      Stats &st = *fr.stats;
+      if (ok)
+      {
+        st.successes++;
+        st.bytes += consumed;
+      }
+      else
+      {
+        st.failures++;
+        if (consumed > 0) st.backtracks++;
+      }
+      if (--st.depth == 0) st.inclusive_ns += ns;
+      st.exclusive_ns += ns - std::min(ns, fr.child_ns);
+      if (!stack.empty()) stack.back().child_ns += ns;
+    }
+    /*!
+     * Start timing a document, see Document
+     * @return false when a document is already being timed
+     */
+    bool open_document()
+    {
+      if (in_doc) return false;
+      in_doc = true;
+      return true;
+    }
+    /*!
+     * Record the parse time of the document being timed
+     * @param ns nanoseconds
+     */
+    void close_document(uint64_t ns)
+    {
+      in_doc = false;
+      docs.record(ns);
+    }
+    /*!
+     * Latency of every document: one sample per Parser::parse(std::string_view) call,
+     * per input of parse_batch, and per Document scope around parses from a state
+     */
+    const Histogram &latency() const { return docs; }
+    /*! Live invocations, outermost first */
+    const std::vector<Frame> &frames() const { return stack; }
+    /*!
+     * Add the counters of a profile taken on another thread
+     * @param o profile, must not be active
+     */
+    void merge(const Profile &o)
+    {
+      for (const auto &kv : o.stats) stats[kv.first].add(kv.second);
+      for (const auto &kv : o.folds) folds[kv.first] += kv.second;
+      docs.merge(o.docs);
+    }
+    /*! Forget all counters, stacks and latencies */
+    void clear()
+    {
+      stats.clear();
+      folds.clear();
+      docs.clear();
+    }
+    /*!
+     * Render the recorded stacks in folded format, one "outer;inner value" line per stack,
+     * ready for flamegraph.pl. Values are nanoseconds when exact and samples when sampled.
+     * Semicolons in labels become colons and control characters become spaces.
+     * @return folded stacks
+     */
+    std::string folded() const
+    {
+      std::map<std::string, uint64_t> merged;
+      for (const auto &kv : folds)
+      {
+        std::string key;
+        for (const std::string *l : kv.first)
+        {
+          if (!key.empty()) key += ';';
+          for (const char c : *l) key += c == ';' ? ':' : (unsigned char)c < 0x20 ? ' ' : c;
+        }
+        merged[key] += kv.second;
+      }
+      std::string res;
+      for (const auto &kv : merged) res += kv.first + " " + std::to_string(kv.second) + "\n";
+      return res;
+    }
+    /*!
+     * Counters merged by label text
+     * @return rows sorted by exclusive time, then by calls
+     */
+    std::vector<std::pair<std::string, Stats>> rows() const
+    {
+      std::map<std::string, Stats> merged;
+      for (const auto &kv : stats) merged[*kv.first].add(kv.second);
+      std::vector<std::pair<std::string, Stats>> res(merged.begin(), merged.end());
+      std::stable_sort(res.begin(), res.end(), [](const auto &a, const auto &b) {
+        return a.second.exclusive_ns != b.second.exclusive_ns ? a.second.exclusive_ns > b.second.exclusive_ns : a.second.calls > b.second.calls;
+      });
+      return res;
+    }
+    /*!
+     * Render the rows as an aligned text table
+     * @return table
+     */
+    std::string table() const
+    {
+      const std::vector<std::pair<std::string, Stats>> rs = rows();
+      size_t w = 5;
+      for (const auto &r : rs) w = std::max(w, r.first.size());
+      char line[128];
+      std::snprintf(line, sizeof(line), "%12s %12s %12s %14s %12s %12s %12s\n", "calls", "ok", "fail", "bytes", "backtracks", "incl ms", "excl ms");
+      std::string res = "label" + std::string(w - 5, ' ') + line;
+      for (const auto &r : rs)
+      {
+        const Stats &st = r.second;
+        std::snprintf(line, sizeof(line), "%12llu %12llu %12llu %14llu %12llu %12.3f %12.3f\n",
+          (unsigned long long)st.calls, (unsigned long long)st.successes, (unsigned long long)st.failures,
+          (unsigned long long)st.bytes, (unsigned long long)st.backtracks, st.inclusive_ns / 1e6, st.exclusive_ns / 1e6);
+        res += r.first + std::string(w - r.first.size(), ' ') + line;
+      }
+      return res;
+    }
+    /*!
+     * Render the rows as a JSON array of objects
+     * @return JSON text
+     */
+    std::string json() const
+    {
+      std::string res = "[";
+      for (const auto &r : rows())
+      {
+        const Stats &st = r.second;
+        if (res.size() > 1) res += ",";
+        res += "\n  {\"label\": \"";
+        for (const char c : r.first)
+        {
+          if (c == '"' || c == '\\')
+            res += std::string("\\") + c;
+          else if ((unsigned char)c < 0x20)
+          {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            res += esc;
+          }
+          else
+            res += c;
+        }
+        res += "\", \"calls\": " + std::to_string(st.calls) + ", \"successes\": " + std::to_string(st.successes) +
+          ", \"failures\": " + std::to_string(st.failures) + ", \"bytes\": " + std::to_string(st.bytes) +
+          ", \"backtracks\": " + std::to_string(st.backtracks) + ", \"inclusive_ns\": " + std::to_string(st.inclusive_ns) +
+          ", \"exclusive_ns\": " + std::to_string(st.exclusive_ns) + "}";
+      }
+      return res + (res.size() > 1 ? "\n]" : "]");
+    }
+  };
+
+  /*! Profile recording on the calling thread, null when profiling is off */
+  inline Profile *&active()
+  {
+    thread_local Profile *p = nullptr;
+    return p;
+  }
+
+  /*! Activates a profile on the calling thread for the lifetime of the scope */
+  class Scope
+  {
+  private:
+    Profile *prev; //!< profile active before the scope
+
+  public:
+    Scope(Profile &p) : prev(active()) { active() = &p; }
+    Scope(const Scope &) = delete;
+    ~Scope() { active() = prev; }
+  };
+
+  /*!
+   * Times one document into the latency of the profile active on the calling thread, if any.
+   * Parser::parse(std::string_view) and parse_batch open one per input, open one yourself
+   * around a parse from a state. Documents opened inside another are not timed.
+   */
+  class Document
+  {
+  private:
+    Profile *prof;           //!< profile to record into, null when off or nested
+    clock::time_point start; //!< time of construction
+
+  public:
+    Document() : prof(active() && active()->open_document() ? active() : nullptr), start(clock::now()) {}
+    Document(const Document &) = delete;
+    ~Document()
+    {
+      if (prof) prof->close_document(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+    }
+  };
+}
+
+// allocation accounting
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::alloc
+{
+  inline std::atomic<uint64_t> calls{0};       //!< calls to the global operator new
+  inline std::atomic<uint64_t> bytes{0};       //!< bytes requested from the global operator new
+  inline std::atomic<bool> installed{false};   //!< flag to indicate the counting hooks are linked in
+
+  /*! Count one allocation, called by the hooks */
+  inline void record(size_t n)
+  {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /*!
+   * Allocations made since construction, by every thread.
+   * Counting needs the hooks: define PARSER_ALLOC_HOOKS before including this header
+   * in exactly one translation unit of the program to replace the global operator new and delete.
+   * Only operator new is seen: direct malloc calls, and the exception objects the runtime
+   * allocates for every throw (a failed parse throws Fail), are not counted.
+   */
+  class Scope
+  {
+  private:
+    const uint64_t calls0; //!< calls at construction
+    const uint64_t bytes0; //!< bytes at construction
+
+  public:
+    Scope() : calls0(calls.load()), bytes0(bytes.load()) {}
+    /*! Number of allocations since construction */
+    uint64_t allocations() const { return calls.load() - calls0; }
+    /*! Bytes allocated since construction */
+    uint64_t allocated() const { return bytes.load() - bytes0; }
+  };
+}
+
+// parser class
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser
+{
+  /*!
+   * Prediction summary of a parser: the bytes it can start with and whether it can
+   * succeed without consuming. Computed when a parser is constructed from the summaries
+   * of its operands, combinators use it to skip attempts that cannot succeed.
+   * It also carries the labels a failed attempt would record at its start, so a skipped
+   * attempt reports the same expectations as one that ran.
+   * Parsers built from a bare parsing function get the conservative any().
+   */
+  struct First
+  {
+    std::bitset<256> set; //!< bytes a successful parse can start with
+    bool nullable;        //!< flag to indicate parser can succeed consuming nothing
+    std::vector<std::string_view> labels = {}; //!< labels recorded by a failure at the start, in recording order
+
+    /*! Summary admitting every input */
+    static First any()
+    {
+      return First{std::bitset<256>().set(), true};
+    }
+    /*! Summary of a parser that never consumes */
+    static First none()
+    {
+      return First{std::bitset<256>(), true};
+    }
+    /*!
+     * Summary of a parser consuming exactly one byte of a class
+     * @param cls class
+     */
+    static First of(const chars::CharClass &cls)
+    {
+      return First{cls.bits(), false};
+    }
+    /*!
+     * Check whether a parse could succeed on the given next byte
+     * @param c next byte as returned by State::peek
+     * @return false only if the parse must fail
+     */
+    const bool admits(int c) const { return nullable || (c >= 0 && set[c]); }
+    /*! Summary of this followed by b */
+    First then(const First &b) const
+    {
+      return First{nullable ? set | b.set : set, nullable && b.nullable, nullable ? merge(labels, b.labels) : labels};
+    }
+    /*! Summary of this or b */
+    First either(const First &b) const { return First{set | b.set, nullable || b.nullable, merge(labels, b.labels)}; }
+    /*! Summary of zero or more repetitions of this */
+    First repeat() const { return First{set, true, labels}; }
+    /*! Summary of a parser labelled l wrapping one summarized by this */
+    First labelled(std::string_view l) const { return l.empty() ? *this : First{set, nullable, merge(labels, {l})}; }
+
+  private:
+    /*! Labels of a followed by those of b not already in a */
+    static std::vector<std::string_view> merge(const std::vector<std::string_view> &a, const std::vector<std::string_view> &b)
+    {
+      std::vector<std::string_view> res = a;
+      for (std::string_view l : b)
+        if (std::find(res.begin(), res.end(), l) == res.end()) res.push_back(l);
+      return res;
+    }
+  };
+
+  /*!
+   * Parser wrapping a parsing function over a state.
+   * Failure is signalled by throwing Fail. On the way up each labelled parser records
+   * itself in the state's farthest failure record, which is updated in place, and only a
+   * parse from a string copies the state into the thrown Fail with the report as its label.
+   * Parsers are immutable once constructed and combinators capture their operands by pointer,
+   * all data that changes during a parse lives in the state,
+   * so one grammar can be shared by any number of threads each parsing its own state.
+   * @tparam T type of parsed value
+   * @tparam X type of user data in state
+   */
+  template <typename T, typename X = state::empty>
+  class Parser
+  {
+  public:
+    using S = state::State<X>;     //!< state parsed over
+    using Fail = std::vector<S>;   //!< thrown on failure, holds the failed state only when thrown by parse(string_view)
+    const std::function<T(S &)> f; //!< parsing function
+    const std::string label;       //!< label recorded in the farthest failure record
+    const First first;             //!< prediction summary
+    const vm::Pat pattern;         //!< recognizer lowered for the bytecode vm, null when opaque
+    const std::shared_ptr<const scan::Class> cls; //!< byte class when this is a bare sat, lets many scan runs
+
+    /*!
+     * Constructor for labelled parser
+     * @param l label
+     * @param _f parsing function
+     * @param _first prediction summary, must admit every input _f can succeed on
+     * @param _pattern recognizer accepting exactly what _f accepts, null when opaque.
+     * Combinators carry their operands' patterns through value functions, which therefore must not reject input
+     * @param _cls class of bytes when _f consumes and returns exactly one member byte
+     */
+    Parser(std::string l, std::function<T(S &)> _f, First _first = First::any(), vm::Pat _pattern = nullptr,
+      std::shared_ptr<const scan::Class> _cls = nullptr)
+      : f(_f), label(l), first(_first.labelled(label)), pattern(_pattern), cls(_cls) {}
+    /*!
+     * Constructor for unlabelled parser
+     * @param _f parsing function
+     */
+    Parser(std::function<T(S &)> _f) : f(_f), label(""), first(First::any()), pattern(nullptr), cls(nullptr) {}
+
+    /*!
+     * Run parser on a state, recording this parser in the farthest failure record on failure
+     * @param s state
+     * @return parsed value
+     */
+    T parse(S &s) const
+    {
+#ifdef PARSER_PROFILE
+      if (profile::Profile *prof = profile::active(); prof && !label.empty()) return profiled(s, *prof);
+#endif
+      const int i = s.get_pos();
+      try
+      {
+        return f(s);
+      }
+      catch (Fail &e)
+      {
+        if (!label.empty()) s.expect(i, label);
+        throw;
+      }
+    }
+    /*!
+     * Run parser on a string, views in the value point into str.
+     * On failure the thrown Fail holds the state, failed with the farthest failure report.
+     * @param str source
+     * @return parsed value
+     */
+    T parse(std::string_view str) const
+    {
+#ifdef PARSER_PROFILE
+      const profile::Document doc;
+#endif
+      state::StateView<X> s(str);
+      try
+      {
+        return parse(s);
+      }
+      catch (Fail &e)
+      {
+        s.fail(s.report());
+        e.push_back(s);
+        throw;
+      }
+    }
+
+    /*!
+     * Compile the recognizer of this parser to bytecode, semantic actions are dropped
+     * @return program
+     */
+    vm::Program compile() const
+    {
+      return vm::compile(pattern);
+    }
+    /*!
+     * Compile the recognizer of this parser if it has one, captures are left out
+     * since callers only need the extent
+     * @return shared program, null when this parser is opaque or calls a rule that is undefined or opaque
+     */
+    std::shared_ptr<const vm::Program> program() const
+    {
+      if (!pattern) return nullptr;
+      try
+      {
+        return std::make_shared<const vm::Program>(vm::compile(pattern, {}, false));
+      }
+      catch (std::invalid_argument &e)
+      {
+        return nullptr;
+      }
+    }
+    /*!
+     * Move past what this parser accepts without building its value.
+     * Runs prog on the vm over contiguous sources, otherwise parses and drops the value.
+     * @param s state
+     * @param prog result of program(), may be null
+     */
+    void recognize(S &s, const vm::Program *prog) const
+    {
+      if (!prog || !s.is_contiguous())
+      {
+        parse(s);
+        return;
+      }
+      const vm::Match m = vm::run(*prog, s.rest());
+      if (!m.ok)
+      {
+        if (!label.empty()) s.expect(s.get_pos(), label);
+        throw Fail();
+      }
+      s.set_pos(s.get_pos() + m.end);
+    }
+
+    /*!
+     * Sequence this parser with another, combining both values
+     * @param l label
+     * @param b parser to run after this one
+     * @param g function combining both values, must not throw Fail
+     * @return sequenced parser
+     */
+    template <typename V, typename U>
+    Parser<V, X> *seq(std::string l, const Parser<U, X> *b, std::function<V(T, U)> g) const
+    {
+      return new Parser<V, X>(l, [this, b, g](S &s) {
+        T x = parse(s);
+        return g(x, b->parse(s));
+      }, first.then(b->first), vm::seq(pattern, b->pattern));
+    }
+    template <typename V, typename U>
+    Parser<V, X> *seq(const Parser<U, X> *b, std::function<V(T, U)> g) const
+    {
+      return seq<V, U>("", b, g);
+    }
+    /*!
+     * Sequence this parser with another, pairing both values
+     * @param l label
+     * @param b parser to run after this one
+     * @return sequenced parser
+     */
+    template <typename U>
+    Parser<alg::Both<T, U>, X> *seq(std::string l, const Parser<U, X> *b) const
+    {
+      return seq<alg::Both<T, U>, U>(l, b, [](T x, U y) -> alg::Both<T, U> {
+        return alg::Both<T, U>(x, y);
+      });
+    }
+    template <typename U>
+    Parser<alg::Both<T, U>, X> *seq(const Parser<U, X> *b) const
+    {
+      return seq<U>("", b);
+    }
+
+    /*!
+     * Sequence this parser with another, keeping only this parser's value.
+     * The other parser runs as a recognizer so its value is never built.
+     * @param l label
+     * @param b parser to run after this one
+     * @return sequenced parser
+     */
+    template <typename U>
+    Parser<T, X> *keep_left(std::string l, const Parser<U, X> *b) const
+    {
+      const std::shared_ptr<const vm::Program> prog = b->program();
+      return new Parser<T, X>(l, [this, b, prog](S &s) {
+        T x = parse(s);
+        b->recognize(s, prog.get());
+        return x;
+      }, first.then(b->first), vm::seq(pattern, b->pattern));
+    }
+    template <typename U>
+    Parser<T, X> *keep_left(const Parser<U, X> *b) const
+    {
+      return keep_left<U>("", b);
+    }
+    /*!
+     * Sequence this parser with another, keeping only the other parser's value.
+     * This parser runs as a recognizer so its value is never built.
+     * @param l label
+     * @param b parser to run after this one
+     * @return sequenced parser
+     */
+    template <typename U>
+    Parser<U, X> *keep_right(std::string l, const Parser<U, X> *b) const
+    {
+      const std::shared_ptr<const vm::Program> prog = program();
+      return new Parser<U, X>(l, [this, b, prog](S &s) {
+        recognize(s, prog.get());
+        return b->parse(s);
+      }, first.then(b->first), vm::seq(pattern, b->pattern));
+    }
+    template <typename U>
+    Parser<U, X> *keep_right(const Parser<U, X> *b) const
+    {
+      return keep_right<U>("", b);
+    }
+
+    /*!
+     * Try this parser, on failure backtrack and try another
+     * @param l label
+     * @param b parser to try on failure
+     * @return alternative parser
+     */
+    template <typename U>
+    Parser<alg::Either<T, U>, X> *alt(std::string l, const Parser<U, X> *b) const
+    {
+      return new Parser<alg::Either<T, U>, X>(l, [this, b](S &s) {
+        if (first.admits(s.peek()))
+        {
+          const int i = s.get_pos();
+          try
+          {
+            return alg::Left<T, U>(parse(s));
+          }
+          catch (Fail &e)
+          {
+            s.set_pos(i);
+          }
+        }
+        else
+          pruned(s);
+        return alg::Right<T, U>(b->parse(s));
+      }, first.either(b->first), vm::choice(pattern, b->pattern));
+    }
+    template <typename U>
+    Parser<alg::Either<T, U>, X> *alt(const Parser<U, X> *b) const
+    {
+      return alt<U>("", b);
+    }
+
+    /*!
+     * Transform the parsed value. The recognizer is the operand's, so g must not reject
+     * the value by throwing Fail, use check for that.
+     * @param l label
+     * @param g transformation
+     * @return mapped parser
+     */
+    template <typename U>
+    Parser<U, X> *map(std::string l, std::function<U(T)> g) const
+    {
+      return new Parser<U, X>(l, [this, g](S &s) {
+        return g(parse(s));
+      }, first, pattern);
+    }
+    template <typename U>
+    Parser<U, X> *map(std::function<U(T)> g) const
+    {
+      return map<U>("", g);
+    }
+    /*!
+     * Transform the parsed value with access to the state, g must not throw Fail
+     * @param l label
+     * @param g transformation
+     * @return mapped parser
+     */
+    template <typename U>
+    Parser<U, X> *map(std::string l, std::function<U(T, S &)> g) const
+    {
+      return new Parser<U, X>(l, [this, g](S &s) {
+        T x = parse(s);
+        return g(x, s);
+      }, first, pattern);
+    }
+    template <typename U>
+    Parser<U, X> *map(std::function<U(T, S &)> g) const
+    {
+      return map<U>("", g);
+    }
+    /*!
+     * Reject parsed values failing a semantic check, restoring the position.
+     * Acceptance depends on the value, so the result is opaque and recognizers run the parser.
+     * @param l label
+     * @param ok check on the parsed value
+     * @return checked parser
+     */
+    Parser<T, X> *check(std::string l, std::function<bool(const T &)> ok) const
+    {
+      return new Parser<T, X>(l, [this, ok](S &s) {
+        const int i = s.get_pos();
+        T x = parse(s);
+        if (ok(x)) return x;
+        s.set_pos(i);
+        throw Fail();
+      }, first);
+    }
+    Parser<T, X> *check(std::function<bool(const T &)> ok) const
+    {
+      return check("", ok);
+    }
+
+    /*!
+     * Repeat this parser until it fails or stops consuming.
+     * Repeating a bare sat over a contiguous source scans the whole run at once.
+     * @param at_least_one fail unless at least one repetition succeeds
+     * @param reserve number of elements to reserve up front
+     * @return repeating parser
+     */
+    Parser<std::vector<T>, X> *many(bool at_least_one = false, size_t reserve = 0) const
+    {
+      return new Parser<std::vector<T>, X>("", [this, at_least_one, reserve](S &s) -> std::vector<T> {
+        if constexpr (std::is_same_v<T, char>)
+          if (cls && s.is_contiguous())
+          {
+            const std::string_view run = scan_run(s, at_least_one);
+            return std::vector<char>(run.begin(), run.end());
+          }
+        std::vector<T> res;
+        res.reserve(reserve);
+        if (!repeat(s, [&](T &&x) { res.push_back(std::move(x)); }) && at_least_one) throw Fail();
+        return res;
+      }, at_least_one ? first : first.repeat(), at_least_one ? vm::seq(pattern, vm::star(pattern)) : vm::star(pattern));
+    }
+    Parser<std::vector<T>, X> *some() const
+    {
+      return many(true);
+    }
+    /*!
+     * Repeat this parser folding the values into an accumulator, without building a vector
+     * @param init initial accumulator
+     * @param step function combining the accumulator with the next value, must not throw Fail
+     * @param at_least_one fail unless at least one repetition succeeds
+     * @return folding parser
+     */
+    template <typename A>
+    Parser<A, X> *fold_many(A init, std::function<A(A, T)> step, bool at_least_one = false) const
+    {
+      return new Parser<A, X>("", [this, init, step, at_least_one](S &s) -> A {
+        A acc = init;
+        if constexpr (std::is_same_v<T, char>)
+          if (cls && s.is_contiguous())
+          {
+            for (char c : scan_run(s, at_least_one)) acc = step(std::move(acc), c);
+            return acc;
+          }
+        if (!repeat(s, [&](T &&x) { acc = step(std::move(acc), std::move(x)); }) && at_least_one) throw Fail();
+        return acc;
+      }, at_least_one ? first : first.repeat(), at_least_one ? vm::seq(pattern, vm::star(pattern)) : vm::star(pattern));
+    }
+    /*!
+     * Repeat this parser dropping the values
+     * @param at_least_one fail unless at least one repetition succeeds
+     * @return parser of the number of repetitions
+     */
+    Parser<size_t, X> *skip_many(bool at_least_one = false) const
+    {
+      return new Parser<size_t, X>("", [this, at_least_one](S &s) -> size_t {
+        if constexpr (std::is_same_v<T, char>)
+          if (cls && s.is_contiguous()) return scan_run(s, at_least_one).size();
+        const size_t n = repeat(s, [](T &&) {});
+        if (at_least_one && n == 0) throw Fail();
+        return n;
+      }, at_least_one ? first : first.repeat(), at_least_one ? vm::seq(pattern, vm::star(pattern)) : vm::star(pattern));
+    }
+
+    /*!
+     * Parallel many over records each terminated by a character.
+     * Records are split at the terminator and parsed independently on the pool,
+     * the result is the longest prefix of records this parser consumes entirely,
+     * matching many over this parser followed by the terminator.
+     * This parser must not consume the terminator.
+     * Falls back to sequential parsing when the source is not contiguous.
+     * @param term record terminator
+     * @param pool pool to run on
+     * @return repeating parser
+     */
+    Parser<std::vector<T>, X> *par_many(char term, sched::Pool &pool = sched::Pool::shared()) const
+    {
+      sched::Pool *pl = &pool;
+      return new Parser<std::vector<T>, X>([this, term, pl](S &s) -> std::vector<T> {
+        if (!s.is_contiguous()) return seq_sep(s, term, true);
+        const std::string_view src = s.rest();
+        std::vector<std::pair<size_t, size_t>> slices;
+        for (size_t b = 0, e; (e = src.find(term, b)) != std::string_view::npos; b = e + 1)
+          slices.emplace_back(b, e);
+        return par_run(s, src, slices, 1, *pl);
+      });
+    }
+    /*!
+     * Parallel many over elements separated by a character.
+     * Elements are split at the separator up to the first stop character
+     * and parsed independently on the pool,
+     * the result is the longest prefix of elements this parser consumes entirely,
+     * matching a sequential separated-by over this parser.
+     * This parser must not consume the separator or stop character.
+     * Falls back to sequential parsing when the source is not contiguous.
+     * @param sep element separator
+     * @param stop character ending the sequence, not consumed
+     * @param pool pool to run on
+     * @return repeating parser
+     */
+    Parser<std::vector<T>, X> *par_sep_by(char sep, char stop = '\0', sched::Pool &pool = sched::Pool::shared()) const
+    {
+      sched::Pool *pl = &pool;
+      return new Parser<std::vector<T>, X>([this, sep, stop, pl](S &s) -> std::vector<T> {
+        if (!s.is_contiguous()) return seq_sep(s, sep, false);
+        std::string_view src = s.rest();
+        src = src.substr(0, src.find(stop));
+        std::vector<std::pair<size_t, size_t>> slices;
+        size_t b = 0;
+        for (size_t e; (e = src.find(sep, b)) != std::string_view::npos; b = e + 1)
+          slices.emplace_back(b, e);
+        slices.emplace_back(b, src.size());
+        return par_run(s, src, slices, 0, *pl);
+      });
+    }
+
+    /*!
+     * Parse many independent inputs on the pool.
+     * Each worker reuses one state for all inputs it handles,
+     * results are written into one preallocated vector in input order.
+     * @param inputs sources to be parsed, must outlive the call
+     * @param pool pool to run on
+     * @param latency_ns when given, filled with the parse time of every input
+     * @return parsed value of every input, empty where parsing failed
+     */
+    std::vector<std::optional<T>> parse_batch(const std::vector<std::string_view> &inputs, sched::Pool &pool = sched::Pool::shared(), std::vector<uint64_t> *latency_ns = nullptr) const
+    {
+      const size_t n = inputs.size();
+      std::vector<std::optional<T>> out(n);
+      std::vector<std::exception_ptr> errs(n);
+      std::vector<std::optional<state::StateView<X>>> states(pool.size());
+      if (latency_ns) latency_ns->assign(n, 0);
+      pool.run(n, [&](size_t k, size_t w) {
+        if (!states[w]) states[w].emplace(inputs[k]);
+        states[w]->reset(inputs[k]);
+        const auto t0 = latency_ns ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        try
+        {
+#ifdef PARSER_PROFILE
+          const profile::Document doc;
+#endif
+          out[k].emplace(parse(*states[w]));
+        }
+        catch (Fail &e) {}
+        catch (...)
+        {
+          errs[k] = std::current_exception();
+        }
+        if (latency_ns)
+          (*latency_ns)[k] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+      });
+      for (std::exception_ptr &e : errs)
+        if (e) std::rethrow_exception(e);
+      return out;
+    }
+
+  private:
+#ifdef PARSER_PROFILE
+    /*! Parse recording this invocation in a profile */
+    T profiled(S &s, profile::Profile &prof) const
+    {
+      const int i = s.get_pos();
+      prof.enter(label);
+      try
+      {
+        T x = f(s);
+        prof.leave(true, s.get_pos() - i);
+        return x;
+      }
+      catch (Fail &e)
+      {
+        prof.leave(false, s.get_pos() - i);
+        s.expect(i, label);
+        throw;
+      }
+      catch (...)
+      {
+        prof.leave(false, s.get_pos() - i);
+        throw;
+      }
+    }
+#endif
+    /*! Record an attempt skipped by first set prediction as the failure it would have been */
+    void pruned(S &s) const
+    {
+      for (std::string_view l : first.labels) s.expect(s.get_pos(), l);
+    }
+    /*! Run this parser until it fails or stops consuming, handing each value to each */
+    template <typename G>
+    size_t repeat(S &s, G &&each) const
+    {
+      size_t n = 0;
+      while (true)
+      {
+        if (!first.admits(s.peek()))
+        {
+          pruned(s);
+          break;
+        }
+        const int i = s.get_pos();
+        try
+        {
+          each(parse(s));
+        }
+        catch (Fail &e)
+        {
+          s.set_pos(i);
+          break;
+        }
+        n++;
+        if (s.get_pos() == i) break;
+      }
+      return n;
+    }
+    /*!
+     * Consume the run of cls at the head of a contiguous source, recording this parser's
+     * label where the run ends as repeat does for the attempt that stops it
+     */
+    std::string_view scan_run(S &s, bool at_least_one) const
+    {
+      const std::string_view src = s.rest();
+      const size_t k = scan::span(*cls, src.data(), src.size());
+      if (!label.empty()) s.expect(s.get_pos() + k, label);
+      if (at_least_one && k == 0) throw Fail();
+      s.set_pos(s.get_pos() + k);
+      return src.substr(0, k);
+    }
+    /*! Parse slices of src on the pool, advancing s past the longest successful prefix */
+    std::vector<T> par_run(S &s, std::string_view src, const std::vector<std::pair<size_t, size_t>> &slices, int skip, sched::Pool &pool) const
+    {
+      const size_t n = slices.size();
+      std::vector<std::optional<T>> out(n);
+      std::vector<std::exception_ptr> errs(n);
+      std::vector<std::vector<state::Error>> recovered(n);
+      std::atomic<size_t> first_fail(n);
+      pool.run(n, [&](size_t k, size_t) {
+        if (k > first_fail.load(std::memory_order_relaxed)) return;
+        state::StateView<X> _s(src.substr(slices[k].first, slices[k].second - slices[k].first));
+        _s.data = s.data;
+        bool ok = false;
+        try
+        {
+          out[k].emplace(parse(_s));
+          ok = _s.rest().empty();
+          if (!_s.get_errors().empty()) recovered[k] = _s.get_errors();
+        }
+        catch (Fail &e) {}
+        catch (...)
+        {
+          errs[k] = std::current_exception();
+        }
+        if (ok) return;
+        size_t f = first_fail.load();
+        while (k < f && !first_fail.compare_exchange_weak(f, k)) {}
+      });
+      const size_t k = first_fail.load();
+      if (k < n && errs[k]) std::rethrow_exception(errs[k]);
+      std::vector<T> res;
+      res.reserve(k);
+      const int base = s.get_pos();
+      for (size_t j = 0; j < k; j++)
+      {
+        res.push_back(std::move(*out[j]));
+        for (state::Error &e : recovered[j])
+        {
+          e.pos += base + slices[j].first;
+          s.add_error(std::move(e));
+        }
+      }
+      if (k > 0) s.set_pos(s.get_pos() + slices[k - 1].second + skip);
+      return res;
+    }
+    /*! Sequential fallback for par_many (terminated) and par_sep_by (separated) */
+    std::vector<T> seq_sep(S &s, char c, bool terminated) const
+    {
+      std::vector<T> res;
+      while (true)
+      {
+        const int i = s.get_pos();
+        try
+        {
+          if (!terminated && !res.empty() && s.adv() != c) throw Fail();
+          T x = parse(s);
+          if (terminated && s.adv() != c) throw Fail();
+          res.push_back(x);
+        }
+        catch (Fail &e)
+        {
+          s.set_pos(i);
+          break;
+        }
+      }
+      return res;
+    }
+  };
+
+  /*!
+   * Parser standing for a grammar rule defined later, so grammars can refer to themselves.
+   * Its pattern calls the rule by reference, so recursive grammars still lower to bytecode
+   * and run on the vm's explicit stack, the rule is compiled once as a subroutine.
+   * Define a rule before compiling or validating a grammar that uses it.
+   * @tparam T type of parsed value
+   * @tparam X type of user data in state
+   */
+  template <typename T, typename X = state::empty>
+  class Rule : public Parser<T, X>
+  {
+  private:
+    /*! Definition shared by the parsing function and the pattern */
+    struct Slot
+    {
+      const Parser<T, X> *body = nullptr; //!< definition, null until defined
+      std::shared_ptr<vm::Pat> pattern = std::make_shared<vm::Pat>(); //!< pattern of the definition
+    };
+    const std::shared_ptr<Slot> slot; //!< definition
+
+    Rule(std::string name, std::shared_ptr<Slot> _slot)
+      : Parser<T, X>(name, [name, _slot](typename Parser<T, X>::S &s) -> T {
+          if (!_slot->body) throw std::logic_error("rule " + name + " is not defined");
+          return _slot->body->parse(s);
+        }, First::any(), vm::ref(name, _slot->pattern)), slot(_slot) {}
+
+  public:
+    /*!
+     * Constructor
+     * @param name rule name, used as label
+     */
+    Rule(std::string name) : Rule(name, std::make_shared<Slot>()) {}
+
+    /*!
+     * Define the rule
+     * @param body parser the rule stands for
+     */
+    void define(const Parser<T, X> *body) const
+    {
+      slot->body = body;
+      *slot->pattern = body->pattern;
+    }
+  };
+
+  /*! Outcome of validating an input */
+  struct Verdict
+  {
+    bool ok;    //!< flag to indicate the input was accepted
+    size_t pos; //!< index after the accepted prefix, or the farthest index a test failed at
+  };
+
+  /*!
+   * Recognize-only runner of a grammar: accepts or rejects an input without building values.
+   * Grammars that lower to bytecode, recursive ones through rules included, are compiled once here
+   * and run on the vm, where semantic actions do not exist and runs of a byte class are scanned
+   * a vector at a time. Define every rule of the grammar before constructing the validator.
+   * Opaque grammars fall back to parsing and dropping the value.
+   * @tparam T type of value the grammar would build
+   * @tparam X type of user data in state
+   */
+  template <typename T, typename X = state::empty>
+  class Validator
+  {
+  private:
+    const Parser<T, X> *p;                      //!< grammar
+    const std::shared_ptr<const vm::Program> prog; //!< compiled recognizer, null when opaque
+
+  public:
+    using S = typename Parser<T, X>::S;
+
+    /*!
+     * Constructor
+     * @param _p grammar
+     */
+    Validator(const Parser<T, X> *_p) : p(_p), prog(_p->program()) {}
+
+    /*! Flag whether validation runs on the vm */
+    bool compiled() const { return prog != nullptr; }
+
+    /*!
+     * Validate a prefix of the rest of a state, advancing it past the accepted prefix
+     * @param s state
+     * @return verdict, pos counts from the state's position
+     */
+    Verdict check(S &s) const
+    {
+      const int i = s.get_pos();
+      if (prog && s.is_contiguous())
+      {
+        const vm::Match m = vm::run(*prog, s.rest());
+        if (m.ok) s.set_pos(i + m.end);
+        return Verdict{m.ok, m.ok ? m.end : m.far};
+      }
+      try
+      {
+        p->parse(s);
+        return Verdict{true, (size_t)(s.get_pos() - i)};
+      }
+      catch (typename Parser<T, X>::Fail &e)
+      {
+        const int far = std::max(i, s.get_far());
+        s.set_pos(i);
+        return Verdict{false, (size_t)(far - i)};
+      }
+    }
+    /*!
+     * Validate a prefix of a string
+     * @param str source
+     * @return verdict
+     */
+    Verdict check(std::string_view str) const
+    {
+      state::StateView<X> s(str);
+      return check(s);
+    }
+    /*!
+     * Validate a whole string, trailing input is rejected at the end of the accepted prefix
+     * @param str source
+     * @return verdict
+     */
+    Verdict check_all(std::string_view str) const
+    {
+      const Verdict v = check(str);
+      return v.ok && v.pos != str.size() ? Verdict{false, v.pos} : v;
+    }
+  };
+}
+
+// primitive parser auxilliary functions
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::util
+{
+  inline bool digit_pred(char c) { return chars::digit.has(c); }
+  inline bool lower_pred(char c) { return chars::lower.has(c); }
+  inline bool upper_pred(char c) { return chars::upper.has(c); }
+  inline bool letter_pred(char c) { return chars::letter.has(c); }
+  inline bool alphanum_pred(char c) { return chars::alphanum.has(c); }
+  inline bool space_pred(char c) { return chars::space.has(c); }
+
+  /*! Concatenate characters into a string */
+  inline std::string str_of_charvec(std::vector<char> res) { return std::string(res.begin(), res.end()); }
+  /*! Read characters as a decimal integer */
+  inline int int_of_charvec(std::vector<char> res) { return std::stoi(str_of_charvec(res)); }
+}
+
+// primitive parsers
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::parsers
+{
+  using namespace parser::util;
+  using Fail = Parser<char>::Fail;
+
+  inline const Parser<int> *const empty = new Parser<int>("empty", [](state::State<> &s) { return 0; }, First::none(), vm::empty());
+
+  /*!
+   * Parse one character satisfying a predicate.
+   * The predicate is called on every byte parsed and may depend on outside state,
+   * so the parser is opaque to prediction, scanning and lowering, use the CharClass overload for those.
+   * @param pred predicate
+   * @param label label
+   * @return character parser
+   */
+  inline const Parser<char> *sat(std::function<bool(char)> pred, std::string label = "")
+  {
+    return new Parser<char>(label, [pred](state::State<> &s) -> char {
+      const int i = s.get_pos();
+      const char c = s.adv();
+      if (pred(c)) return c;
+      s.set_pos(i);
+      throw Fail();
+    }, First::any());
+  }
+  /*!
+   * Parse one character of a class, membership is a single table load
+   * @param cls class
+   * @param label label
+   * @return character parser
+   */
+  inline const Parser<char> *sat(chars::CharClass cls, std::string label = "")
+  {
+    const First first = First::of(cls);
+    return new Parser<char>(label, [cls](state::State<> &s) -> char {
+      const int i = s.get_pos();
+      const char c = s.adv();
+      if (cls.has(c)) return c;
+      s.set_pos(i);
+      throw Fail();
+    }, first, vm::set(first.set), std::make_shared<const scan::Class>(first.set));
+  }
+
+  /*!
+   * Parse the longest run of characters of a class, scanning contiguous sources
+   * a vector at a time
+   * @param cls class
+   * @param label label
+   * @return run parser, the value is a slice of the input
+   */
+  inline const Parser<std::string_view> *take_while(chars::CharClass cls, std::string label = "")
+  {
+    const First first = First::of(cls);
+    const std::shared_ptr<const scan::Class> run = std::make_shared<const scan::Class>(first.set);
+    return new Parser<std::string_view>(label, [run](state::State<> &s) -> std::string_view {
+      const int i = s.get_pos();
+      if (s.is_contiguous())
+      {
+        const std::string_view src = s.rest();
+        const size_t k = scan::span(*run, src.data(), src.size());
+        s.set_pos(i + k);
+        return src.substr(0, k);
+      }
+      for (int c = s.peek(); c >= 0 && run->table[c]; c = s.peek()) s.adv();
+      return s.slice(i, s.get_pos());
+    }, first.repeat(), vm::star(vm::set(first.set)));
+  }
+  /*!
+   * Parse the longest run of characters satisfying a predicate, evaluated once per byte up front
+   * @param pred predicate
+   * @param label label
+   * @return run parser
+   */
+  inline const Parser<std::string_view> *take_while(std::function<bool(char)> pred, std::string label = "")
+  {
+    return take_while(chars::CharClass::of(pred), label);
+  }
+
+  inline const Parser<char> *const digit = sat(chars::digit, "digit");
+  inline const Parser<char> *const lower = sat(chars::lower, "lower");
+  inline const Parser<char> *const upper = sat(chars::upper, "upper");
+  inline const Parser<char> *const letter = sat(chars::letter, "letter");
+  inline const Parser<char> *const alphanum = sat(chars::alphanum, "alphanum");
+  inline const Parser<char> *const space = sat(chars::space, "space");
+
+  inline const Parser<char> *char_match(char c)
+  {
+    return sat(chars::CharClass::of(c), "char_match('" + std::string(1, c) + "')");
+  }
+  /*!
+   * Parse a literal string.
+   * On contiguous sources literals of up to eight bytes are compared as one masked word
+   * and longer ones with a single memcmp, the value is a view of the literal held by the parser
+   * so matching never allocates.
+   * @param str literal
+   * @return literal parser
+   */
+  inline const Parser<std::string_view> *string_match(std::string str)
+  {
+    const std::shared_ptr<const std::string> lit = std::make_shared<const std::string>(str);
+    uint64_t word = 0, mask = 0;
+    if (str.size() <= 8)
+    {
+      unsigned char m[8] = {0};
+      std::memset(m, 0xff, str.size());
+      std::memcpy(&word, str.data(), str.size());
+      std::memcpy(&mask, m, 8);
+    }
+    return new Parser<std::string_view>("string_match('" + str + "')", [lit, word, mask](state::State<> &s) -> std::string_view {
+      const std::string_view l = *lit;
+      const int i = s.get_pos();
+      if (s.is_contiguous())
+      {
+        const std::string_view src = s.rest();
+        bool ok;
+        if (l.size() <= 8 && src.size() >= 8)
+        {
+          uint64_t w;
+          std::memcpy(&w, src.data(), 8);
+          ok = ((w ^ word) & mask) == 0;
+        }
+        else
+          ok = src.size() >= l.size() && std::memcmp(src.data(), l.data(), l.size()) == 0;
+        if (!ok) throw Fail();
+        s.set_pos(i + l.size());
+        return l;
+      }
+      try
+      {
+        for (char _c : l)
+          if (s.adv() != _c) throw Fail();
+      }
+      catch (Fail &e)
+      {
+        // also reached when the source ends partway through the literal
+        s.set_pos(i);
+        throw;
+      }
+      return l;
+    }, str.empty() ? First::none() : First::of(chars::CharClass::of(str[0])), vm::lit(str));
+  }
+
+  /*!
+   * Parse the longest of a set of literals in one pass.
+   * The literals are compiled into a trie whose transitions are indexed by the bytes
+   * that occur in any literal, so each input byte costs one table load.
+   * @param lits literals, the first of duplicates wins
+   * @param label label
+   * @return parser of the index of the matched literal and a view of it
+   */
+  inline const Parser<alg::Both<size_t, std::string_view>> *one_of_literals(std::vector<std::string> lits, std::string label = "")
+  {
+    /*! Trie over byte classes, node 0 is the root */
+    struct Trie
+    {
+      uint16_t cls[256] = {0};     //!< class of each byte, 0 for bytes in no literal, up to 256
+      size_t width = 1;            //!< number of classes
+      std::vector<int32_t> next;   //!< transition per node and class, -1 if none
+      std::vector<int32_t> accept; //!< literal ending at each node, -1 if none
+      std::vector<std::string> lits; //!< literals
+    };
+    const std::shared_ptr<Trie> t = std::make_shared<Trie>();
+    t->lits = lits;
+    for (const std::string &l : lits)
+      for (unsigned char c : l)
+        if (!t->cls[c]) t->cls[c] = t->width++;
+    t->next.assign(t->width, -1);
+    t->accept.assign(1, -1);
+    First first{std::bitset<256>(), false};
+    vm::Pat pattern = nullptr;
+    std::vector<size_t> order(lits.size());
+    for (size_t k = 0; k < lits.size(); k++)
+    {
+      int32_t node = 0;
+      for (unsigned char c : lits[k])
+      {
+        int32_t &n = t->next[node * t->width + t->cls[c]];
+        if (n < 0)
+        {
+          n = t->accept.size();
+          t->accept.push_back(-1);
+          t->next.resize(t->next.size() + t->width, -1);
+        }
+        node = t->next[node * t->width + t->cls[c]];
+      }
+      if (t->accept[node] < 0) t->accept[node] = k;
+      first = first.either(lits[k].empty() ? First::none() : First::of(chars::CharClass::of(lits[k][0])));
+      order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return lits[a].size() > lits[b].size(); });
+    for (size_t k : order)
+      pattern = pattern ? vm::choice(pattern, vm::lit(lits[k])) : vm::lit(lits[k]);
+    return new Parser<alg::Both<size_t, std::string_view>>(label, [t](state::State<> &s) -> alg::Both<size_t, std::string_view> {
+      const int i = s.get_pos();
+      int32_t node = 0, best = t->accept[0];
+      size_t len = 0, best_len = 0;
+      auto step = [&](unsigned char c) -> bool {
+        const uint16_t k = t->cls[c];
+        if (!k || (node = t->next[node * t->width + k]) < 0) return false;
+        len++;
+        if (t->accept[node] >= 0)
+        {
+          best = t->accept[node];
+          best_len = len;
+        }
+        return true;
+      };
+      if (s.is_contiguous())
+      {
+        const std::string_view src = s.rest();
+        for (size_t j = 0; j < src.size() && step(src[j]); j++) {}
+      }
+      else
+        for (int c = s.peek(); c >= 0 && step(c); c = s.peek()) s.adv();
+      s.set_pos(i + best_len);
+      if (best < 0) throw Fail();
+      return alg::Both<size_t, std::string_view>(best, t->lits[best]);
+    }, lits.empty() ? First{std::bitset<256>(), false} : first, pattern ? pattern : vm::set(std::bitset<256>()));
+  }
+
+  /*!
+   * Run a parser purely as a recognizer and return the input it consumed.
+   * Parsers that lower to bytecode run on the vm over contiguous sources, so no value
+   * is built and nothing is allocated, semantic actions of such parsers do not run.
+   * Other parsers run normally and their value is dropped.
+   * @param p parser
+   * @param label label
+   * @return parser of the consumed slice of the input
+   */
+  template <typename T>
+  inline const Parser<std::string_view> *capture(const Parser<T> *p, std::string label = "")
+  {
+    // compiled here, or on first use when p calls a rule that is not defined yet
+    struct Lazy
+    {
+      std::once_flag once;                     //!< guards compilation
+      std::shared_ptr<const vm::Program> prog; //!< compiled recognizer, null when opaque
+    };
+    const std::shared_ptr<Lazy> lazy = std::make_shared<Lazy>();
+    if (std::shared_ptr<const vm::Program> prog = p->program())
+      std::call_once(lazy->once, [&] { lazy->prog = prog; });
+    return new Parser<std::string_view>(label, [p, lazy](state::State<> &s) -> std::string_view {
+      std::call_once(lazy->once, [&] { lazy->prog = p->program(); });
+      const int i = s.get_pos();
+      p->recognize(s, lazy->prog.get());
+      return s.slice(i, s.get_pos());
+    }, p->first, vm::capture(p->pattern));
+  }
+
+  inline const Parser<std::string_view> *const ident = capture(lower->seq(alphanum->many()), "ident");
+
+  /*!
+   * Parse an integer straight from the input.
+   * Decimal runs are accumulated eight digits at a time, other bases go through std::from_chars.
+   * A value that does not fit I is a parse failure like any other,
+   * the lowered recognizer runs the same range checked scan so recognizing agrees with parsing.
+   * @tparam I integer type
+   * @param base 2, 8, 10 or 16
+   * @param sign accept a leading '-', only for signed I
+   * @param label label
+   * @return integer parser
+   */
+  template <typename I>
+  inline const Parser<I> *integral(int base = 10, bool sign = std::is_signed_v<I>, std::string label = "")
+  {
+    sign = sign && std::is_signed_v<I>;
+    const chars::CharClass digits =
+      base == 2 ? chars::CharClass::range('0', '1') :
+      base == 8 ? chars::CharClass::range('0', '7') :
+      base == 16 ? chars::hex : chars::digit;
+    const chars::CharClass minus = chars::CharClass::of('-');
+    // length of the integer at the start of src and its value, SIZE_MAX when there is none or it does not fit I
+    auto read = [base, sign, digits](std::string_view src, I &x) -> size_t {
+      const bool neg = sign && !src.empty() && src[0] == '-';
+      const size_t k = neg;
+      if (k == src.size() || !digits.has(src[k])) return SIZE_MAX;
+      if (base == 10)
+      {
+        uint64_t v;
+        bool overflow;
+        const size_t len = k + scan::decimal(src.data() + k, src.size() - k, v, overflow);
+        const uint64_t max = std::numeric_limits<I>::max();
+        if (overflow || v > max + neg) return SIZE_MAX;
+        x = !neg ? (I)v : v == max + 1 ? std::numeric_limits<I>::min() : -(I)v;
+        return len;
+      }
+      const std::from_chars_result r = std::from_chars(src.data(), src.data() + src.size(), x, base);
+      if (r.ec != std::errc()) return SIZE_MAX;
+      return r.ptr - src.data();
+    };
+    return new Parser<I>(label, [sign, digits, read](state::State<> &s) -> I {
+      const int i = s.get_pos();
+      std::string buf;
+      std::string_view src;
+      if (s.is_contiguous())
+        src = s.rest();
+      else
+      {
+        if (sign && s.peek() == '-') buf += s.adv();
+        for (int c = s.peek(); c >= 0 && digits.has(c); c = s.peek()) buf += s.adv();
+        s.set_pos(i);
+        src = buf;
+      }
+      I x;
+      const size_t len = read(src, x);
+      if (len == SIZE_MAX) throw Fail();
+      s.set_pos(i + len);
+      return x;
+    }, First::of(sign ? digits | minus : digits), vm::native([read](std::string_view src) {
+      I x;
+      return read(src, x);
+    }));
+  }
+
+  /*!
+   * Parse a decimal floating point number of the form -?(d+(.d*)?|.d+)([eE][+-]?d+)?
+   * The extent is scanned in one pass and converted with std::from_chars,
+   * no intermediate string is built on contiguous sources.
+   * A value out of range of F is a parse failure, the lowered recognizer runs the same scan and conversion.
+   * @tparam F floating point type
+   * @param label label
+   * @return floating point parser
+   */
+  template <typename F>
+  inline const Parser<F> *floating(std::string label = "")
+  {
+    // length of the number at the start of src and its value, SIZE_MAX when there is none or it is out of range
+    auto read = [](std::string_view src, F &x) -> size_t {
+      const size_t n = src.size();
+      size_t k = 0;
+      auto digits = [&] {
+        const size_t from = k;
+        while (k < n && chars::digit.has(src[k])) k++;
+        return k - from;
+      };
+      if (k < n && src[k] == '-') k++;
+      size_t m = digits();
+      if (k < n && src[k] == '.')
+      {
+        k++;
+        m += digits();
+      }
+      if (m == 0) return SIZE_MAX;
+      if (k < n && (src[k] == 'e' || src[k] == 'E'))
+      {
+        const size_t mark = k++;
+        if (k < n && (src[k] == '+' || src[k] == '-')) k++;
+        if (digits() == 0) k = mark;
+      }
+      const std::from_chars_result r = std::from_chars(src.data(), src.data() + k, x);
+      if (r.ec != std::errc() || r.ptr != src.data() + k) return SIZE_MAX;
+      return k;
+    };
+    return new Parser<F>(label, [read](state::State<> &s) -> F {
+      const int i = s.get_pos();
+      std::string buf;
+      std::string_view src;
+      if (s.is_contiguous())
+        src = s.rest();
+      else
+      {
+        for (int c = s.peek(); c >= 0 && (chars::digit | chars::CharClass::of(".eE+-")).has(c); c = s.peek()) buf += s.adv();
+        s.set_pos(i);
+        src = buf;
+      }
+      F x;
+      const size_t len = read(src, x);
+      if (len == SIZE_MAX) throw Fail();
+      s.set_pos(i + len);
+      return x;
+    }, First::of(chars::digit | chars::CharClass::of("-.")), vm::native([read](std::string_view src) {
+      F x;
+      return read(src, x);
+    }));
+  }
+
+  inline const Parser<std::vector<char>> *const digit_some = digit->some();
+  inline const Parser<int> *const nat = integral<int>(10, false, "nat");
+  inline const Parser<int> *const intg = integral<int>(10, true, "intg");
+  inline const Parser<double> *const real = floating<double>("real");
+
+  inline const Parser<std::string_view> *const spaces = take_while(chars::space, "spaces");
+
+  /*!
+   * Parse p between two delimiters, the delimiters run as recognizers
+   * so their values are never built
+   * @param open opening parser
+   * @param p parser
+   * @param close closing parser
+   * @param label label
+   * @return parser of p's value
+   */
+  template <typename A, typename T, typename B>
+  inline const Parser<T> *between(const Parser<A> *open, const Parser<T> *p, const Parser<B> *close, std::string label = "")
+  {
+    return open->keep_right(p)->keep_left(label, close);
+  }
+
+  /*!
+   * Surround a parser with optional whitespace on both sides
+   * @param p parser
+   * @param label label
+   * @return token parser
+   */
+  template <typename T>
+  inline const Parser<T> *token(const Parser<T> *p, std::string label = "")
+  {
+    return between(spaces, p, spaces, label);
+  }
+  inline const Parser<std::string_view> *const identifier = token<std::string_view>(ident, "identifier");
+  inline const Parser<int> *const natural = token<int>(nat, "natural");
+  inline const Parser<int> *const integer = token<int>(intg, "integer");
+  inline const Parser<std::string_view> *symbol(std::string str)
+  {
+    return token<std::string_view>(string_match(str), "symbol");
+  }
+
+  /*!
+   * Skip input up to the next byte of a synchronization set, which is not consumed.
+   * Contiguous sources are scanned a vector at a time.
+   * @param sync bytes to stop at
+   * @param label label
+   * @return parser of the skipped input
+   */
+  inline const Parser<std::string_view> *skip_until(chars::CharClass sync, std::string label = "")
+  {
+    return take_while(~sync, label);
+  }
+
+  /*!
+   * Declare a grammar rule to be defined later with Rule::define
+   * @param name rule name, used as label
+   * @return rule
+   */
+  template <typename T>
+  inline Rule<T> *rule(std::string name)
+  {
+    return new Rule<T>(name);
+  }
+
+  /*!
+   * Run p, and on failure record an error in the state instead of failing.
+   * The input is then skipped from where p started through the next byte of the
+   * synchronization set, so a repetition of the recovering parser continues with the
+   * next record. At the end of input there is nothing to skip and the failure is passed on.
+   * Recorded errors are read with State::get_errors, par_many and
+   * par_sep_by carry the errors of their elements over to the outer state.
+   * @param p parser
+   * @param sync bytes ending a record, the first one found is consumed
+   * @param label label
+   * @return parser of p's value, empty where p failed
+   */
+  template <typename T>
+  inline const Parser<std::optional<T>> *recover(const Parser<T> *p, chars::CharClass sync, std::string label = "")
+  {
+    const Parser<std::string_view> *skip = skip_until(sync);
+    return new Parser<std::optional<T>>(label, [p, skip, sync](state::State<> &s) -> std::optional<T> {
+      const int i = s.get_pos();
+      try
+      {
+        return p->parse(s);
+      }
+      catch (Fail &e)
+      {
+        s.set_pos(i);
+        if (s.peek() < 0) throw;
+        s.recover_from(i);
+        skip->parse(s);
+        const int c = s.peek();
+        if (c >= 0 && sync.has(c)) s.adv();
+        return std::nullopt;
+      }
+    }, First{std::bitset<256>().set(), p->first.nullable, p->first.labels});
+  }
+}
+
+// tree rendering
+///////////////////////////////////////////////////////////////////////////////
+
+namespace parser::render
+{
+  /*!
+   * Destination of rendered text. Renderers only hand it pieces of existing text,
+   * so output is produced in one pass without building intermediate strings.
+   */
+  class Sink
+  {
+  public:
+    virtual ~Sink() {}
+    /*!
+     * Append bytes that may not outlive the call
+     * @param p bytes
+     * @param n number of bytes
+     */
+    virtual void write(const char *p, size_t n) = 0;
+    /*!
+     * Append bytes that stay valid until the output is consumed, such as literals and
+     * text owned by the rendered tree, sinks may keep a reference instead of copying
+     * @param v bytes
+     */
+    virtual void ref(std::string_view v) { write(v.data(), v.size()); }
+    /*!
+     * Append n spaces
+     * @param n number of spaces
+     */
+    void pad(size_t n)
+    {
+      static const char spaces[] = "                                                                ";
+      for (; n > 0; n -= std::min(n, sizeof(spaces) - 1)) ref(std::string_view(spaces, std::min(n, sizeof(spaces) - 1)));
+    }
+  };
+
+  /*! Sink writing into an output stream, which does the buffering */
+  class StreamSink : public Sink
+  {
+  private:
+    std::ostream &os; //!< destination
+
+  public:
+    StreamSink(std::ostream &_os) : os(_os) {}
+    void write(const char *p, size_t n) override { os.write(p, n); }
+  };
+
+  /*! Sink appending to a string */
+  class StringSink : public Sink
+  {
+  private:
+    std::string &out; //!< destination
+
+  public:
+    StringSink(std::string &_out) : out(_out) {}
+    void write(const char *p, size_t n) override { out.append(p, n); }
+  };
+
+  /*! Piece of output laid out like struct iovec so the list can be handed to writev */
+  struct Chunk
+  {
+    const void *base; //!< first byte
+    size_t len;       //!< number of bytes
+  };
+
+  /*!
+   * Sink collecting a list of chunks. Referenced text is not copied,
+   * written text is copied into blocks owned by the sink, adjacent pieces are merged.
+   */
+  class ChunkSink : public Sink
+  {
+  private:
+    static constexpr size_t block = 4096;       //!< size of a copy block
+    std::vector<Chunk> list;                    //!< chunks in output order
+    std::vector<std::unique_ptr<char[]>> blocks; //!< storage of copied bytes
+    size_t used = block;                        //!< bytes used in the last block
+
+    /*! Append a chunk, extending the last one when contiguous */
+    void push(const char *p, size_t n)
+    {
+      if (n == 0) return;
+      if (!list.empty() && (const char *)list.back().base + list.back().len == p)
+        list.back().len += n;
+      else
+        list.push_back(Chunk{p, n});
+    }
+
+  public:
+    void write(const char *p, size_t n) override
+    {
+      if (n > block)
+      {
+        // own block, kept before the partly used one
+        char *dst = blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), std::unique_ptr<char[]>(new char[n]))->get();
+        std::memcpy(dst, p, n);
+        push(dst, n);
+        return;
+      }
+      if (used + n > block)
+      {
+        blocks.emplace_back(new char[block]);
+        used = 0;
+      }
+      char *dst = blocks.back().get() + used;
+      std::memcpy(dst, p, n);
+      used += n;
+      push(dst, n);
+    }
+    void ref(std::string_view v) override { push(v.data(), v.size()); }
+    /*! Chunks in output order, valid while the sink and the referenced text live */
+    const std::vector<Chunk> &chunks() const { return list; }
+    /*! Total number of bytes */
+    size_t size() const
+    {
+      size_t n = 0;
+      for (const Chunk &c : list) n += c.len;
+      return n;
+    }
+    /*! Concatenate the chunks */
+    std::string str() const
+    {
+      std::string res;
+      res.reserve(size());
+      for (const Chunk &c : list) res.append((const char *)c.base, c.len);
+      return res;
+    }
+  };
+
+  /*! Value held by a tree node, renders itself into a sink */
+  class RenderItem
+  {
+  public:
+    virtual ~RenderItem() {}
+    /*!
+     * Render as part of an S-expression
+     * @param out sink
+     * @param sep indentation of continuation lines
+     */
+    virtual void to_sexp(Sink &out, int sep) const = 0;
+    /*! Render as part of an outline, defaults to the S-expression form */
+    virtual void to_stub(Sink &out, int sep) const { to_sexp(out, sep); }
+    /*! Render as part of a LaTeX qtree, defaults to the S-expression form */
+    virtual void to_latex(Sink &out, int sep) const { to_sexp(out, sep); }
+  };
+
+  /*! Item holding a piece of text */
+  class Text : public RenderItem
+  {
+  public:
+    const std::string text; //!< text
+
+    Text(std::string _text) : text(std::move(_text)) {}
+    void to_sexp(Sink &out, int sep) const override { out.ref(text); }
+    /*! Render with the characters LaTeX treats specially escaped */
+    void to_latex(Sink &out, int sep) const override
+    {
+      size_t from = 0;
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        const char *esc = nullptr;
+        switch (text[i])
+        {
+        case '#': esc = "\\#"; break;
+        case '$': esc = "\\$"; break;
+        case '%': esc = "\\%"; break;
+        case '&': esc = "\\&"; break;
+        case '_': esc = "\\_"; break;
+        case '{': esc = "\\{"; break;
+        case '}': esc = "\\}"; break;
+        case '~': esc = "\\textasciitilde{}"; break;
+        case '^': esc = "\\textasciicircum{}"; break;
+        case '\\': esc = "\\textbackslash{}"; break;
+        }
+        if (!esc) continue;
+        out.ref(std::string_view(text).substr(from, i - from));
+        out.ref(esc);
+        from = i + 1;
+      }
+      out.ref(std::string_view(text).substr(from));
+    }
+  };
+
+  /*!
+   * Tree of render items. Every renderer streams into a sink in one pass over the tree,
+   * linear in the output size, using an explicit stack so depth is not bounded by the native stack.
+   */
+  class Node
+  {
+  public:
+    std::shared_ptr<const RenderItem> data; //!< value, may be null
+    std::vector<Node> children;             //!< children in order
+
+    Node() {}
+    Node(std::shared_ptr<const RenderItem> val) : data(std::move(val)) {}
+    Node(std::string text) : data(std::make_shared<const Text>(std::move(text))) {}
+
+    /*!
+     * Append a child
+     * @param c child
+     * @return this node
+     */
+    Node &add_child(const Node &c)
+    {
+      children.push_back(c);
+      return *this;
+    }
+
+    /*!
+     * Render as an S-expression, children on their own lines indented by two more spaces
+     * @param out sink
+     * @param sep indentation of this node's continuation lines
+     */
+    void to_sexp(Sink &out, int sep = 0) const
+    {
+      walk(sep, [&out](const Node &n, int sep) {
+        out.ref("( ");
+        if (n.data) n.data->to_sexp(out, sep + 2);
+      }, [&out](int sep) {
+        out.ref("\n");
+        out.pad(sep);
+      }, [&out](const Node &, int) { out.ref(" )"); });
+    }
+    /*! Render as an S-expression into a string */
+    std::string to_sexp(int sep = 0) const
+    {
+      std::string str;
+      StringSink out(str);
+      to_sexp(out, sep);
+      return str;
+    }
+    /*!
+     * Render as an outline, one "- item" line per node indented by depth
+     * @param out sink
+     * @param sep indentation of this node
+     */
+    void to_stub(Sink &out, int sep = 0) const
+    {
+      walk(sep, [&out](const Node &n, int sep) {
+        out.pad(sep);
+        out.ref("- ");
+        if (n.data) n.data->to_stub(out, sep + 2);
+        out.ref("\n");
+      }, [](int) {}, [](const Node &, int) {});
+    }
+    /*! Render as an outline into a string */
+    std::string to_stub(int sep = 0) const
+    {
+      std::string str;
+      StringSink out(str);
+      to_stub(out, sep);
+      return str;
+    }
+    /*!
+     * Render as a LaTeX qtree, "\\Tree [.{item} children ]"
+     * @param out sink
+     * @param sep indentation of this node's continuation lines
+     */
+    void to_latex(Sink &out, int sep = 0) const
+    {
+      out.ref("\\Tree ");
+      walk(sep, [&out](const Node &n, int sep) {
+        out.ref("[.{");
+        if (n.data) n.data->to_latex(out, sep + 2);
+        out.ref("}");
+      }, [&out](int sep) {
+        out.ref("\n");
+        out.pad(sep);
+      }, [&out](const Node &, int) { out.ref(" ]"); });
+    }
+    /*! Render as a LaTeX qtree into a string */
+    std::string to_latex(int sep = 0) const
+    {
+      std::string str;
+      StringSink out(str);
+      to_latex(out, sep);
+      return str;
+    }
+
+  private:
+    /*!
+     * Visit the tree depth first
+     * @param sep indentation of this node
+     * @param open called on entering a node with its indentation
+     * @param gap called before each child with the child's indentation
+     * @param close called on leaving a node with its indentation
+     */
+    template <typename Open, typename Gap, typename Close>
+    void walk(int sep, Open &&open, Gap &&gap, Close &&close) const
+    {
+      struct Frame
+      {
+        const Node *n; //!< node
+        size_t next;   //!< next child to visit
+        int sep;       //!< indentation
+      };
+      vm::SmallStack<Frame, 32> stack;
+      open(*this, sep);
+      stack.push_back(Frame{this, 0, sep});
+      while (!stack.empty())
+      {
+        Frame &f = stack.back();
+        if (f.next == f.n->children.size())
+        {
+          close(*f.n, f.sep);
+          stack.pop_back();
+          continue;
+        }
+        const Node &c = f.n->children[f.next++];
+        const int csep = f.sep + 2;
+        gap(csep);
+        open(c, csep);
+        stack.push_back(Frame{&c, 0, csep});
+      }
+    }
+  };
+}
+
+// allocation hooks
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef PARSER_ALLOC_HOOKS
+static const bool parser_alloc_hooks = (parser::alloc::installed = true);
+
+// only operator new is counted, malloc and the exception objects allocated for each throw
+// bypass these hooks. Every replaced operator goes through this pair, kept out of line so
+// the compiler does not pair the inlined free with an operator new at call sites
+#if defined(__GNUC__) || defined(__clang__)
+#define PARSER_ALLOC_NOINLINE __attribute__((noinline))
+#else
+#define PARSER_ALLOC_NOINLINE
+#endif
+
+/*! Count and allocate n bytes aligned to al, 0 for the default alignment, null on failure */
+PARSER_ALLOC_NOINLINE static void *parser_alloc_acquire(size_t n, size_t al) noexcept
+{
+  parser::alloc::record(n);
+  if (al <= alignof(std::max_align_t)) return std::malloc(n ? n : 1);
+  return std::aligned_alloc(al, (n + al - 1) / al * al);
+}
+/*! Release memory of parser_alloc_acquire */
+PARSER_ALLOC_NOINLINE static void parser_alloc_release(void *p) noexcept { std::free(p); }
+
+void *operator new(size_t n)
+{
+  if (void *p = parser_alloc_acquire(n, 0)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n) { return ::operator new(n); }
+void *operator new(size_t n, std::align_val_t al)
+{
+  if (void *p = parser_alloc_acquire(n, (size_t)al)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n, std::align_val_t al) { return ::operator new(n, al); }
+void *operator new(size_t n, const std::nothrow_t &) noexcept { return parser_alloc_acquire(n, 0); }
+void *operator new[](size_t n, const std::nothrow_t &) noexcept { return parser_alloc_acquire(n, 0); }
+void *operator new(size_t n, std::align_val_t al, const std::nothrow_t &) noexcept { return parser_alloc_acquire(n, (size_t)al); }
+void *operator new[](size_t n, std::align_val_t al, const std::nothrow_t &) noexcept { return parser_alloc_acquire(n, (size_t)al); }
+void operator delete(void *p) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p) noexcept { parser_alloc_release(p); }
+void operator delete(void *p, size_t) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p, size_t) noexcept { parser_alloc_release(p); }
+void operator delete(void *p, std::align_val_t) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { parser_alloc_release(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { parser_alloc_release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { parser_alloc_release(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { parser_alloc_release(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { parser_alloc_release(p); }
+#undef PARSER_ALLOC_NOINLINE
+#endif
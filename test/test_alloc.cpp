@@ -0,0 +1,112 @@
+#define PARSER_ALLOC_HOOKS
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+
+static std::string words(size_t n) {
+  std::string str;
+  for (size_t k = 0; k < n; k++) str += "w" + std::to_string(k) + " ";
+  return str;
+}
+
+TEST_CASE("allocation accounting") {
+  REQUIRE(alloc::installed);
+  SECTION("counts nothrow and aligned operator new") {
+    struct alignas(64) Line { char bytes[64]; };
+    alloc::Scope scope;
+    int *n = new (std::nothrow) int(1);
+    Line *l = new Line;
+    Line *ls = new (std::nothrow) Line[3];
+    REQUIRE((uintptr_t)l % 64 == 0);
+    REQUIRE((uintptr_t)ls % 64 == 0);
+    delete n;
+    delete l;
+    delete[] ls;
+    REQUIRE(scope.allocations() == 3);
+    REQUIRE(scope.allocated() >= sizeof(int) + 4 * sizeof(Line));
+  }
+  SECTION("counts operator new") {
+    alloc::Scope scope;
+    std::vector<int> *v = new std::vector<int>(100);
+    delete v;
+    REQUIRE(scope.allocations() == 2);
+    REQUIRE(scope.allocated() >= sizeof(std::vector<int>) + 100 * sizeof(int));
+  }
+  SECTION("capture does not allocate") {
+    const std::string str = words(1000);
+    auto p = capture(lower->seq(alphanum->many()))->keep_left(char_match(' '));
+    state::StateView<> s(str);
+    size_t n = 0;
+    alloc::Scope scope;
+    while (s.peek() >= 0) n += p->parse(s).size();
+    REQUIRE(scope.allocations() == 0);
+    REQUIRE(n > 1000);
+  }
+  SECTION("primitives do not allocate") {
+    const std::string str = "return 12345, x";
+    auto kw = string_match("return");
+    auto pair = nat->seq(char_match(','));
+    alloc::Scope scope;
+    for (int k = 0; k < 100; k++) {
+      state::StateView<> s(str);
+      kw->parse(s);
+      spaces->parse(s);
+      pair->parse(s);
+      identifier->parse(s);
+    }
+    REQUIRE(scope.allocations() == 0);
+  }
+  SECTION("failures make no operator new calls once the state is warm") {
+    // each throw still allocates its exception object outside operator new, which is not counted
+    auto p = identifier->alt(integer);
+    state::StateView<> s("");
+    REQUIRE_THROWS(p->parse(s));
+    alloc::Scope scope;
+    for (int k = 0; k < 100; k++) {
+      s.reset("+");
+      try {
+        p->parse(s);
+      } catch (Parser<int>::Fail &e) {}
+    }
+    REQUIRE(scope.allocations() == 0);
+  }
+  SECTION("recognizing discarded values does not allocate") {
+    auto list = between(symbol("["), identifier->keep_left(symbol(",")->keep_right(identifier)->skip_many()), symbol("]"));
+    const std::string str = "[a, bc, d]";
+    alloc::Scope scope;
+    for (int k = 0; k < 100; k++) list->parse(str);
+    REQUIRE(scope.allocations() == 0);
+  }
+  SECTION("many allocates in proportion to the input") {
+    const std::string str(1 << 16, '7');
+    auto p = digit->many();
+    auto q = digit->many(false, str.size());
+    alloc::Scope scope;
+    REQUIRE(p->parse(str).size() == str.size());
+    REQUIRE(scope.allocated() < 4 * str.size());
+    alloc::Scope reserved;
+    REQUIRE(q->parse(str).size() == str.size());
+    REQUIRE(reserved.allocations() <= 3);
+  }
+}
+
+TEST_CASE("tree rendering allocations") {
+  render::Node root("root");
+  for (int k = 0; k < 1000; k++) root.add_child(render::Node("leaf").add_child(render::Node("x")));
+  struct Count : render::Sink {
+    size_t n = 0;
+    void write(const char *, size_t len) override { n += len; }
+  } out;
+  alloc::Scope scope;
+  root.to_sexp(out);
+  root.to_stub(out);
+  root.to_latex(out);
+  REQUIRE(scope.allocations() == 0);
+  REQUIRE(out.n > 0);
+}
@@ -0,0 +1,40 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <cctype>
+#include <string>
+
+using namespace parser;
+using namespace parser::chars;
+
+static_assert(digit.has('0') && digit.has('9') && !digit.has('a'), "digit range");
+static_assert((letter & digit) == CharClass(), "intersection");
+static_assert((alphanum - digit) == letter, "difference");
+static_assert(!(~space).has(' ') && (~space).has('x'), "complement");
+static_assert(CharClass::of("+-") == (CharClass::of('+') | CharClass::of('-')), "union");
+static_assert(!alphanum.has((char)0xe9), "classes are ascii");
+
+TEST_CASE("character classes") {
+  SECTION("bits") {
+    std::bitset<256> b = digit.bits();
+    REQUIRE(b.count() == 10);
+    REQUIRE(b['5']);
+  }
+  SECTION("from predicate") {
+    REQUIRE(CharClass::of([](char c) { return c == 'x' || c == 'y'; }) == CharClass::of("xy"));
+  }
+  SECTION("locale opt in") {
+    REQUIRE(CharClass::locale(std::isdigit) == digit);
+    REQUIRE(CharClass::locale(std::isspace) == space);
+  }
+  SECTION("sat over a class") {
+    auto sign = parsers::sat(CharClass::of("+-"), "sign");
+    REQUIRE(sign->parse("-1") == '-');
+    REQUIRE_THROWS(sign->parse("1"));
+    REQUIRE(sign->first.admits('+'));
+    REQUIRE_FALSE(sign->first.admits('1'));
+  }
+  SECTION("high bytes") {
+    REQUIRE_THROWS(parsers::letter->parse(std::string(1, (char)0xe9)));
+    REQUIRE(parsers::sat(~CharClass(), "any")->parse(std::string(1, (char)0xe9)) == (char)0xe9);
+  }
+}
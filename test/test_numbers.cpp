@@ -0,0 +1,135 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+
+TEST_CASE("integers") {
+  SECTION("limits") {
+    REQUIRE(integral<int32_t>()->parse("2147483647") == 2147483647);
+    REQUIRE(integral<int32_t>()->parse("-2147483648") == std::numeric_limits<int32_t>::min());
+    REQUIRE_THROWS(integral<int32_t>()->parse("2147483648"));
+    REQUIRE_THROWS(integral<int32_t>()->parse("-2147483649"));
+    REQUIRE(integral<int64_t>()->parse("-9223372036854775808") == std::numeric_limits<int64_t>::min());
+    REQUIRE(integral<uint64_t>()->parse("18446744073709551615") == std::numeric_limits<uint64_t>::max());
+    REQUIRE_THROWS(integral<uint64_t>()->parse("18446744073709551616"));
+    REQUIRE_THROWS(integral<uint64_t>()->parse("100000000000000000000000"));
+  }
+  SECTION("leading zeros") {
+    REQUIRE(integral<int>()->parse("0000000000000000000000042") == 42);
+  }
+  SECTION("overflow is a clean failure") {
+    std::string str = "99999999999";
+    StateString s(&str);
+    REQUIRE_THROWS_AS(nat->parse(s), Parser<int>::Fail);
+    REQUIRE(s.get_pos() == 0);
+  }
+  SECTION("recognizers reject overflow") {
+    REQUIRE_FALSE(vm::run(nat->compile(), "99999999999").ok);
+    REQUIRE(vm::run(intg->compile(), "-2147483648x").end == 11);
+    REQUIRE_FALSE(Validator<int>(nat).check_all("99999999999").ok);
+    REQUIRE(Validator<int>(nat).check_all("2147483647").ok);
+    REQUIRE_THROWS(capture(nat)->parse("99999999999"));
+    REQUIRE_THROWS(nat->keep_right(char_match('x'))->parse("99999999999x"));
+    REQUIRE(capture(intg)->parse("-42;") == "-42");
+  }
+  SECTION("sign") {
+    REQUIRE(intg->parse("-12") == -12);
+    REQUIRE_THROWS(nat->parse("-12"));
+    REQUIRE_THROWS(integral<unsigned>()->parse("-1"));
+    REQUIRE_THROWS(intg->parse("-"));
+  }
+  SECTION("bases") {
+    REQUIRE(integral<uint32_t>(16)->parse("fFz") == 255);
+    REQUIRE(integral<int>(16)->parse("-1a") == -26);
+    REQUIRE(integral<int>(8)->parse("778") == 63);
+    REQUIRE(integral<uint8_t>(2)->parse("11111111") == 255);
+    REQUIRE_THROWS(integral<uint8_t>(2)->parse("100000000"));
+    REQUIRE_THROWS(integral<int>(2)->parse("2"));
+  }
+  SECTION("extent") {
+    std::string str = "123456789012x";
+    StateString s(&str);
+    REQUIRE(integral<int64_t>()->parse(s) == 123456789012);
+    REQUIRE(s.get_pos() == 12);
+  }
+  SECTION("streams") {
+    std::stringstream stream("-4096;");
+    parser::state::StateIStream<> s(&stream);
+    REQUIRE(intg->parse(s) == -4096);
+    REQUIRE(s.get_pos() == 5);
+  }
+  SECTION("round trip") {
+    std::mt19937_64 rng(3);
+    for (int k = 0; k < 2000; k++) {
+      const int64_t v = (int64_t)rng() >> (rng() % 64);
+      REQUIRE(integral<int64_t>()->parse(std::to_string(v) + ",") == v);
+    }
+  }
+}
+
+TEST_CASE("floating point") {
+  SECTION("forms") {
+    REQUIRE(real->parse("1") == 1.0);
+    REQUIRE(real->parse("-2.5") == -2.5);
+    REQUIRE(real->parse("3.") == 3.0);
+    REQUIRE(real->parse(".25") == 0.25);
+    REQUIRE(real->parse("1e3") == 1000.0);
+    REQUIRE(real->parse("1.5E-2") == 0.015);
+    REQUIRE(real->parse("6.02e+23") == 6.02e23);
+    REQUIRE(floating<float>()->parse("0.1") == 0.1f);
+  }
+  SECTION("rejects") {
+    REQUIRE_THROWS(real->parse("."));
+    REQUIRE_THROWS(real->parse("-"));
+    REQUIRE_THROWS(real->parse("e5"));
+    REQUIRE_THROWS(real->parse("inf"));
+    REQUIRE_THROWS(real->parse("1e999"));
+  }
+  SECTION("extent") {
+    std::string str = "12.5e1x";
+    StateString s(&str);
+    REQUIRE(real->parse(s) == 125.0);
+    REQUIRE(s.get_pos() == 6);
+    str = "7e+,";
+    s.set_pos(0);
+    REQUIRE(real->parse(s) == 7.0);
+    REQUIRE(s.get_pos() == 1);
+  }
+  SECTION("lowering agrees") {
+    vm::Program prog = real->compile();
+    for (std::string str : {"1", "-2.5", "3.", ".25", "1.5E-2x", "7e+,", "12.5e1x"}) {
+      StateString s(&str);
+      real->parse(s);
+      REQUIRE(vm::run(prog, str).end == s.get_pos());
+    }
+    for (std::string str : {"1e999", "-1e999", ".", "-e5"}) {
+      REQUIRE_THROWS(real->parse(str));
+      REQUIRE_FALSE(vm::run(prog, str).ok);
+    }
+    REQUIRE_FALSE(Validator<double>(real).check_all("1e999").ok);
+    REQUIRE_THROWS(capture(real)->parse("1e999"));
+  }
+  SECTION("streams") {
+    std::stringstream stream("-0.75,1");
+    parser::state::StateIStream<> s(&stream);
+    REQUIRE(real->parse(s) == -0.75);
+    REQUIRE(s.get_pos() == 5);
+  }
+  SECTION("round trip") {
+    std::mt19937_64 rng(5);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+    for (int k = 0; k < 2000; k++) {
+      const double v = dist(rng);
+      char buf[64];
+      const std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), v);
+      REQUIRE(real->parse(std::string_view(buf, r.ptr - buf)) == v);
+    }
+  }
+}
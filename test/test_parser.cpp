@@ -0,0 +1,421 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <string>
+#include <vector>
+#include <sstream>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+
+TEST_CASE("primitive parsers") {
+  SECTION("sat") {
+    REQUIRE(digit->parse("1") == '1');
+    REQUIRE_THROWS(digit->parse("a"));
+    REQUIRE_THROWS(digit->parse(""));
+  }
+  SECTION("failed sat does not consume") {
+    std::string str = "a";
+    StateString s(&str);
+    REQUIRE_THROWS(digit->parse(s));
+    REQUIRE(s.get_pos() == 0);
+  }
+  SECTION("string match") {
+    REQUIRE(string_match("hey")->parse("heyo") == "hey");
+    REQUIRE_THROWS(string_match("hey")->parse("he"));
+  }
+  SECTION("string match lengths") {
+    for (size_t n : {1, 7, 8, 9, 16, 40}) {
+      std::string lit;
+      for (size_t k = 0; k < n; k++) lit += (char)('a' + k % 26);
+      auto p = string_match(lit);
+      REQUIRE(p->parse(lit) == lit);
+      REQUIRE(p->parse(lit + std::string(20, 'z')) == lit);
+      std::string bad = lit;
+      bad.back()++;
+      REQUIRE_THROWS(p->parse(bad));
+      REQUIRE_THROWS(p->parse(bad + std::string(20, 'z')));
+      REQUIRE_THROWS(p->parse(lit.substr(0, n - 1)));
+      std::string str = "x" + lit;
+      StateString s(&str);
+      REQUIRE_THROWS(p->parse(s));
+      REQUIRE(s.get_pos() == 0);
+      s.set_pos(1);
+      REQUIRE(p->parse(s) == lit);
+      REQUIRE(s.get_pos() == n + 1);
+    }
+  }
+  SECTION("string match on a truncated stream") {
+    std::stringstream stream("he");
+    parser::state::StateIStream<> s(&stream);
+    REQUIRE_THROWS(string_match("hey")->parse(s));
+    REQUIRE(s.get_pos() == 0);
+    REQUIRE(string_match("he")->parse(s) == "he");
+  }
+  SECTION("string match returns a view of the literal") {
+    auto p = string_match("abc");
+    REQUIRE(p->parse("abc").data() == p->parse("abcd").data());
+  }
+  SECTION("numbers") {
+    REQUIRE(nat->parse("123") == 123);
+    REQUIRE(intg->parse("-42") == -42);
+    REQUIRE(intg->parse("42") == 42);
+  }
+  SECTION("tokens") {
+    REQUIRE(ident->parse("ab1 c") == "ab1");
+    REQUIRE(identifier->parse("  abc  ") == "abc");
+    REQUIRE(integer->parse(" -7 ") == -7);
+    REQUIRE(symbol("+")->parse(" + ") == "+");
+  }
+}
+
+TEST_CASE("combinators") {
+  SECTION("seq") {
+    auto p = digit->seq(letter);
+    alg::Both<char, char> b = p->parse("1a");
+    REQUIRE(b.lx == '1');
+    REQUIRE(b.rx == 'a');
+    REQUIRE_THROWS(p->parse("11"));
+  }
+  SECTION("alt backtracks") {
+    auto p = string_match("ab")->alt(string_match("ac"));
+    alg::Either<std::string_view, std::string_view> e = p->parse("ac");
+    REQUIRE_FALSE(e.left);
+    REQUIRE(e.rx == "ac");
+  }
+  SECTION("many") {
+    std::string str = "123a";
+    StateString s(&str);
+    REQUIRE(digit->many()->parse(s) == std::vector<char>{'1', '2', '3'});
+    REQUIRE(s.get_pos() == 3);
+    REQUIRE(digit->many()->parse("a").empty());
+    REQUIRE_THROWS(digit->some()->parse("a"));
+  }
+  SECTION("map") {
+    REQUIRE(nat->map<int>([](int x) { return x * 2; })->parse("21") == 42);
+  }
+}
+
+TEST_CASE("farthest failure") {
+  SECTION("report") {
+    try {
+      identifier->parse("  1");
+      FAIL("expected failure");
+    } catch (Parser<std::string>::Fail &e) {
+      REQUIRE(e.size() == 1);
+      REQUIRE(e.back().get_fail() == "expected ident at 2");
+    }
+  }
+  SECTION("farthest offset wins across alternatives") {
+    auto p = symbol("let")->keep_right(identifier)->alt(integer);
+    try {
+      p->parse("let 1");
+      FAIL("expected failure");
+    } catch (Parser<int>::Fail &e) {
+      REQUIRE(e.back().get_far() == 4);
+      REQUIRE(e.back().get_expected() == std::vector<std::string_view>{"ident", "identifier"});
+    }
+  }
+  SECTION("labels at the same offset are collected") {
+    auto p = char_match('a')->alt("letter a", digit)->alt("atom", char_match('('));
+    std::string str = "?";
+    StateString s(&str);
+    REQUIRE_THROWS(p->parse(s));
+    REQUIRE(s.get_far() == 0);
+    REQUIRE(s.report() == "expected char_match('a'), digit, letter a, char_match('(') or atom at 0");
+  }
+  SECTION("skipped attempts report the labels inside them") {
+    auto report = [](auto p, std::string str) {
+      StateString s(&str);
+      REQUIRE_THROWS(p->parse(s));
+      return s.report();
+    };
+    REQUIRE(report(digit->alt(letter), "?") == "expected digit or letter at 0");
+    REQUIRE(report(digit->map<char>([](char c) { return c; })->alt(letter), "?") == "expected digit or letter at 0");
+    REQUIRE(report(nat->keep_left(char_match(';'))->some(), "x") == "expected nat at 0");
+    REQUIRE(report(digit->many()->keep_right(letter)->alt(char_match('(')), "?") == "expected digit, letter or char_match('(') at 0");
+    REQUIRE(report(nat->keep_left(char_match(';'))->many()->keep_left(char_match('.')), "1;x") == "expected nat or char_match('.') at 2");
+  }
+  SECTION("report does not depend on the state") {
+    auto some = digit->some();
+    auto run = digit->many()->keep_left(char_match(';'));
+    auto skip = letter->skip_many(true);
+    auto report = [](auto p, std::string str, std::string expected) {
+      StateString a(&str);
+      state::StateView<> b(str);
+      std::stringstream stream(str);
+      state::StateIStream<> c(&stream);
+      REQUIRE_THROWS(p->parse(a));
+      REQUIRE_THROWS(p->parse(b));
+      REQUIRE_THROWS(p->parse(c));
+      REQUIRE(a.report() == expected);
+      REQUIRE(b.report() == expected);
+      REQUIRE(c.report() == expected);
+    };
+    report(some, "x", "expected digit at 0");
+    report(run, "12x", "expected digit or char_match(';') at 2");
+    report(skip, "1", "expected letter at 0");
+  }
+  SECTION("records are reset with the source") {
+    state::StateView<> s("x");
+    REQUIRE_THROWS(nat->parse(s));
+    REQUIRE(s.get_far() == 0);
+    s.reset("1");
+    REQUIRE(s.get_far() == -1);
+    REQUIRE(s.report() == "parse failed");
+  }
+}
+
+/*! Parser of 'a' predicted by its first set, counting how often it runs */
+static const Parser<char> *counted_a(int &calls) {
+  return new Parser<char>("a", [&calls](state::State<> &s) -> char {
+    calls++;
+    if (s.peek() != 'a') throw Parser<char>::Fail();
+    return s.adv();
+  }, First::of(chars::CharClass::of('a')));
+}
+
+TEST_CASE("first set prediction") {
+  SECTION("summaries") {
+    REQUIRE(digit->first.admits('1'));
+    REQUIRE_FALSE(digit->first.admits('a'));
+    REQUIRE_FALSE(digit->first.admits(-1));
+    REQUIRE(digit->many()->first.nullable);
+    REQUIRE_FALSE(digit->some()->first.nullable);
+    REQUIRE(natural->first.admits(' '));
+    REQUIRE(natural->first.admits('7'));
+    REQUIRE_FALSE(natural->first.admits('x'));
+    REQUIRE(intg->first.admits('-'));
+    REQUIRE(string_match("ab")->first.admits('a'));
+    REQUIRE_FALSE(string_match("ab")->first.admits('b'));
+    REQUIRE(empty->first.admits(-1));
+  }
+  SECTION("opaque parsers are conservative") {
+    Parser<int> p([](state::State<> &s) { return 0; });
+    REQUIRE(p.first.admits('x'));
+    REQUIRE(p.first.admits(-1));
+  }
+  SECTION("alt skips branches that cannot match") {
+    int calls = 0;
+    auto counted = counted_a(calls);
+    auto p = counted->alt(digit);
+    REQUIRE_FALSE(p->parse("1").left);
+    REQUIRE(calls == 0);
+    REQUIRE(p->parse("a").left);
+    REQUIRE(calls == 1);
+  }
+  SECTION("many stops without a failed attempt") {
+    int calls = 0;
+    auto counted = counted_a(calls);
+    REQUIRE(counted->map<char>([](char c) { return c; })->many()->parse("aab").size() == 2);
+    REQUIRE(calls == 2);
+  }
+  SECTION("predicates are not tabulated") {
+    bool allow = false;
+    auto p = sat([&allow](char c) { return allow && c == 'a'; });
+    allow = true;
+    REQUIRE(p->parse("a") == 'a');
+    REQUIRE(p->many()->parse("aaa").size() == 3);
+    REQUIRE(p->alt(digit)->parse("a").left);
+    REQUIRE(p->pattern == nullptr);
+  }
+}
+
+TEST_CASE("literal sets") {
+  auto p = one_of_literals({"if", "in", "int", "interface", "=", "==", "=>", "in"});
+  SECTION("longest match") {
+    alg::Both<size_t, std::string_view> r = p->parse("interfaces");
+    REQUIRE(r.lx == 3);
+    REQUIRE(r.rx == "interface");
+    REQUIRE(p->parse("inter").rx == "int");
+    REQUIRE(p->parse("ink").rx == "in");
+    REQUIRE(p->parse("int x").lx == 2);
+    REQUIRE(p->parse("==>").rx == "==");
+    REQUIRE(p->parse("=>").rx == "=>");
+  }
+  SECTION("first duplicate wins") {
+    REQUIRE(p->parse("in").lx == 1);
+  }
+  SECTION("position") {
+    std::string str = "int=";
+    StateString s(&str);
+    p->parse(s);
+    REQUIRE(s.get_pos() == 3);
+    REQUIRE(p->parse(s).rx == "=");
+    REQUIRE_THROWS(p->parse(s));
+    REQUIRE(s.get_pos() == 4);
+  }
+  SECTION("failure does not consume") {
+    std::string str = "ix";
+    StateString s(&str);
+    REQUIRE_THROWS(p->parse(s));
+    REQUIRE(s.get_pos() == 0);
+  }
+  SECTION("streams") {
+    std::stringstream stream("interfac");
+    parser::state::StateIStream<> s(&stream);
+    REQUIRE(p->parse(s).rx == "int");
+    REQUIRE(s.get_pos() == 3);
+  }
+  SECTION("every byte value") {
+    std::string all;
+    for (int c = 0; c < 256; c++) all += (char)c;
+    auto q = one_of_literals({all, std::string(1, (char)255), std::string(1, (char)0)});
+    REQUIRE(q->parse(all).lx == 0);
+    REQUIRE(q->parse(std::string(1, (char)255)).lx == 1);
+    REQUIRE(q->parse(std::string(1, (char)0)).lx == 2);
+  }
+  SECTION("prediction and lowering agree") {
+    REQUIRE(p->first.admits('='));
+    REQUIRE_FALSE(p->first.admits('x'));
+    REQUIRE(vm::run(p->compile(), "interfaces").end == 9);
+  }
+}
+
+TEST_CASE("capture") {
+  SECTION("views into the source") {
+    std::string str = "abc12 rest";
+    StateString s(&str);
+    std::string_view v = ident->parse(s);
+    REQUIRE(v == "abc12");
+    REQUIRE(v.data() == str.data());
+    REQUIRE(s.get_pos() == 5);
+  }
+  SECTION("failure does not consume") {
+    std::string str = "1abc";
+    StateString s(&str);
+    REQUIRE_THROWS(ident->parse(s));
+    REQUIRE(s.get_pos() == 0);
+  }
+  SECTION("numbers and whitespace") {
+    REQUIRE(capture(intg)->parse("-123x") == "-123");
+    REQUIRE(spaces->parse(" \t x") == " \t ");
+    REQUIRE(identifier->parse("  abc  ") == "abc");
+  }
+  SECTION("opaque parsers run normally") {
+    auto p = capture(nat->par_many('\n'));
+    REQUIRE(p->pattern == nullptr);
+    REQUIRE(p->parse("1\n22\nx") == "1\n22\n");
+  }
+  SECTION("streams keep a copy") {
+    std::stringstream stream("ab1+");
+    parser::state::StateIStream<> s(&stream);
+    std::string_view v = ident->parse(s);
+    REQUIRE(v == "ab1");
+    REQUIRE(s.get_pos() == 3);
+  }
+}
+
+TEST_CASE("folding repetition") {
+  SECTION("fold") {
+    auto p = digit->fold_many<int>(0, [](int acc, char c) { return acc * 10 + (c - '0'); });
+    REQUIRE(p->parse("1234x") == 1234);
+    REQUIRE(p->parse("x") == 0);
+    REQUIRE_THROWS(digit->fold_many<int>(0, [](int acc, char) { return acc + 1; }, true)->parse("x"));
+  }
+  SECTION("fold non char values") {
+    auto sum = natural->fold_many<long>(0, [](long acc, int x) { return acc + x; });
+    std::string str = "1 2 3 40 x";
+    StateString s(&str);
+    REQUIRE(sum->parse(s) == 46);
+    REQUIRE(s.get_pos() == 9);
+  }
+  SECTION("skip") {
+    std::string str = "aaab";
+    StateString s(&str);
+    REQUIRE(char_match('a')->skip_many()->parse(s) == 3);
+    REQUIRE(s.get_pos() == 3);
+    REQUIRE(natural->skip_many()->parse("1 2 3") == 3);
+    REQUIRE_THROWS(natural->skip_many(true)->parse("x"));
+  }
+  SECTION("many reserve hint") {
+    REQUIRE(natural->many(false, 64)->parse("1 2 3") == std::vector<int>{1, 2, 3});
+  }
+}
+
+TEST_CASE("value discarding sequence") {
+  SECTION("keep left and right") {
+    REQUIRE(nat->keep_left(char_match(';'))->parse("12;") == 12);
+    REQUIRE(char_match('#')->keep_right(nat)->parse("#7") == 7);
+    REQUIRE_THROWS(nat->keep_left(char_match(';'))->parse("12,"));
+    REQUIRE_THROWS(char_match('#')->keep_right(nat)->parse("7"));
+  }
+  SECTION("between") {
+    auto p = between(symbol("("), integer, symbol(")"));
+    std::string str = " ( -3 ) x";
+    StateString s(&str);
+    REQUIRE(p->parse(s) == -3);
+    REQUIRE(s.get_pos() == 8);
+    REQUIRE_THROWS(p->parse("(3"));
+  }
+  SECTION("discarded values are not built") {
+    int built = 0;
+    auto counted = nat->map<int>([&built](int x) { return built++, x; });
+    REQUIRE(counted->keep_right(char_match('x'))->parse("5x") == 'x');
+    REQUIRE(built == 0);
+    REQUIRE(char_match('x')->keep_left(counted)->parse("x5") == 'x');
+    REQUIRE(built == 0);
+    REQUIRE(counted->keep_left(char_match('x'))->parse("5x") == 5);
+    REQUIRE(built == 1);
+  }
+  SECTION("opaque operands still run") {
+    auto p = nat->par_many('\n')->keep_right(nat);
+    REQUIRE(p->parse("1\n2\n3") == 3);
+  }
+  SECTION("failure labels") {
+    try {
+      nat->keep_left(symbol(";"))->parse("1,");
+      FAIL("expected failure");
+    } catch (Parser<int>::Fail &e) {
+      REQUIRE(e.front().get_expected() == std::vector<std::string_view>{"symbol"});
+    }
+  }
+}
+
+TEST_CASE("error recovery") {
+  auto record = intg->seq(char_match(','))->seq(ident)->keep_left(char_match('\n'));
+  SECTION("skip until") {
+    std::string str = "abc;def";
+    StateString s(&str);
+    REQUIRE(skip_until(chars::CharClass::of(";"))->parse(s) == "abc");
+    REQUIRE(s.get_pos() == 3);
+  }
+  SECTION("every valid record and every error") {
+    auto p = recover(record, chars::CharClass::of('\n'))->many();
+    std::string str = "1,a\nx,b\n3,c\n4,\n5,e\n";
+    StateString s(&str);
+    auto res = p->parse(s);
+    REQUIRE(s.get_pos() == str.size());
+    REQUIRE(res.size() == 5);
+    REQUIRE(res[0].has_value());
+    REQUIRE_FALSE(res[1].has_value());
+    REQUIRE(res[2].has_value());
+    REQUIRE_FALSE(res[3].has_value());
+    REQUIRE(res[4].has_value());
+    REQUIRE(s.get_errors().size() == 2);
+    REQUIRE(s.get_errors()[0].pos == 4);
+    REQUIRE(s.get_errors()[0].expected == "intg");
+    REQUIRE(s.get_errors()[1].pos == 14);
+    REQUIRE(s.get_errors()[1].expected == "ident");
+  }
+  SECTION("unterminated last record") {
+    auto p = recover(record, chars::CharClass::of('\n'))->many();
+    std::string str = "1,a\n2";
+    StateString s(&str);
+    REQUIRE(p->parse(s).size() == 2);
+    REQUIRE(s.get_pos() == 5);
+    REQUIRE(s.get_errors().size() == 1);
+  }
+  SECTION("errors found in parallel slices") {
+    sched::Pool pool(3);
+    auto line = intg->seq(char_match(','))->seq(ident);
+    auto p = recover(line, chars::CharClass::of('\n'))->par_many('\n', pool);
+    std::string str;
+    for (int k = 0; k < 100; k++) str += k % 10 == 3 ? "?,x\n" : std::to_string(k) + ",x\n";
+    StateString s(&str);
+    auto res = p->parse(s);
+    REQUIRE(res.size() == 100);
+    REQUIRE(s.get_errors().size() == 10);
+    for (const state::Error &e : s.get_errors()) REQUIRE(str[e.pos] == '?');
+  }
+}
@@ -0,0 +1,204 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using namespace parser;
+using namespace parser::parsers;
+
+static profile::Stats row(const profile::Profile &prof, const std::string &label) {
+  for (const auto &r : prof.rows())
+    if (r.first == label) return r.second;
+  return profile::Stats();
+}
+
+TEST_CASE("per label profiling") {
+  SECTION("inactive by default") {
+    REQUIRE(profile::active() == nullptr);
+    profile::Profile prof;
+    char_match('a')->parse("a");
+    REQUIRE(prof.rows().empty());
+  }
+  SECTION("counts and bytes") {
+    auto p = char_match('a')->alt(digit)->many();
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      REQUIRE(p->parse("a1a2b").size() == 4);
+    }
+    REQUIRE(profile::active() == nullptr);
+    const profile::Stats a = row(prof, "char_match('a')");
+    REQUIRE(a.calls == 2);
+    REQUIRE(a.successes == 2);
+    REQUIRE(a.bytes == 2);
+    const profile::Stats d = row(prof, "digit");
+    REQUIRE(d.calls == 2);
+    REQUIRE(d.failures == 0);
+  }
+  SECTION("failures and backtracks") {
+    auto p = char_match('a')->seq<char, char>("pair", char_match('b'), [](char, char b) { return b; })->alt(string_match("ac"));
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      p->parse("ac");
+    }
+    const profile::Stats pair = row(prof, "pair");
+    REQUIRE(pair.calls == 1);
+    REQUIRE(pair.failures == 1);
+    REQUIRE(pair.backtracks == 1);
+    REQUIRE(pair.inclusive_ns >= pair.exclusive_ns);
+    REQUIRE(row(prof, "char_match('b')").failures == 1);
+    REQUIRE(row(prof, "char_match('b')").backtracks == 0);
+    REQUIRE(row(prof, "string_match('ac')").bytes == 2);
+  }
+  SECTION("rendering") {
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      nat->parse("12");
+      string_match("\"")->parse("\"");
+    }
+    const std::string table = prof.table();
+    REQUIRE(table.rfind("label", 0) == 0);
+    REQUIRE(table.find("\nnat ") != std::string::npos);
+    const std::string json = prof.json();
+    REQUIRE(json.find("{\"label\": \"nat\", \"calls\": 1, \"successes\": 1, \"failures\": 0, \"bytes\": 2") != std::string::npos);
+    REQUIRE(json.find("\"label\": \"string_match('\\\"')\"") != std::string::npos);
+    REQUIRE(profile::Profile().json() == "[]");
+  }
+  SECTION("merging thread profiles") {
+    profile::Profile total, other;
+    std::thread t([&] {
+      profile::Scope on(other);
+      nat->parse("1");
+    });
+    t.join();
+    {
+      profile::Scope on(total);
+      nat->parse("2");
+    }
+    total.merge(other);
+    REQUIRE(row(total, "nat").calls == 2);
+  }
+}
+
+TEST_CASE("folded stacks") {
+  auto item = char_match('a')->seq<char, char>("item", digit, [](char, char d) { return d; });
+  auto list = item->many()->map<size_t>("list", [](std::vector<char> v) { return v.size(); });
+  SECTION("off by default") {
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      list->parse("a1a2");
+    }
+    REQUIRE(prof.folded().empty());
+  }
+  SECTION("exact") {
+    profile::Profile prof;
+    prof.set_stacks(profile::Stacks::exact);
+    {
+      profile::Scope on(prof);
+      REQUIRE(list->parse("a1a2") == 2);
+    }
+    const std::string folded = prof.folded();
+    REQUIRE(folded.find("list ") != std::string::npos);
+    REQUIRE(folded.find("list;item ") != std::string::npos);
+    REQUIRE(folded.find("list;item;char_match('a') ") != std::string::npos);
+    REQUIRE(folded.find("list;item;digit ") != std::string::npos);
+    REQUIRE(folded.back() == '\n');
+  }
+  SECTION("sampled") {
+    profile::Profile prof;
+    prof.set_stacks(profile::Stacks::sampled, 1);
+    std::string str;
+    for (int k = 0; k < 1000; k++) str += "a1";
+    {
+      profile::Scope on(prof);
+      REQUIRE(list->parse(str) == 1000);
+    }
+    const std::string folded = prof.folded();
+    REQUIRE(folded.rfind("list", 0) == 0);
+    uint64_t samples = 0;
+    for (size_t i = 0; (i = folded.find(' ', i)) != std::string::npos; i++) samples += std::stoull(folded.substr(i + 1));
+    REQUIRE(samples > 0);
+  }
+  SECTION("labels are sanitized") {
+    profile::Profile prof;
+    prof.set_stacks(profile::Stacks::exact);
+    {
+      profile::Scope on(prof);
+      char_match(';')->parse(";");
+      char_match('\n')->parse("\n");
+    }
+    const std::string folded = prof.folded();
+    REQUIRE(std::count(folded.begin(), folded.end(), '\n') == 2);
+    REQUIRE(folded.find("char_match(' ') ") != std::string::npos);
+    REQUIRE(folded.find("char_match(':') ") != std::string::npos);
+  }
+}
+
+TEST_CASE("latency histogram") {
+  SECTION("percentiles within bucket precision") {
+    profile::Histogram h;
+    for (uint64_t v = 1; v <= 100000; v++) h.record(v);
+    REQUIRE(h.count() == 100000);
+    REQUIRE(h.max() == 100000);
+    REQUIRE(h.percentile(50) >= 50000);
+    REQUIRE(h.percentile(50) <= 50000 * 1.008);
+    REQUIRE(h.percentile(99.9) >= 99900);
+    REQUIRE(h.percentile(99.9) <= 100000);
+    REQUIRE(h.percentile(100) == 100000);
+  }
+  SECTION("small values are exact") {
+    profile::Histogram h;
+    for (uint64_t v : {3, 1, 2, 200}) h.record(v);
+    REQUIRE(h.percentile(25) == 1);
+    REQUIRE(h.percentile(50) == 2);
+    REQUIRE(h.percentile(75) == 3);
+    REQUIRE(h.summary() == "p50 2 p90 200 p99 200 p99.9 200 max 200");
+  }
+  SECTION("large values and merging") {
+    profile::Histogram a, b;
+    a.record(1ull << 40);
+    b.record(UINT64_MAX);
+    a.merge(b);
+    REQUIRE(a.count() == 2);
+    REQUIRE(a.percentile(50) >= 1ull << 40);
+    REQUIRE(a.percentile(50) <= (uint64_t)((1ull << 40) * 1.008));
+    REQUIRE(a.max() == UINT64_MAX);
+    REQUIRE(profile::Histogram().percentile(99) == 0);
+  }
+  SECTION("profiles record one latency per top level parse") {
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      for (int k = 0; k < 10; k++) identifier->parse(" abc ");
+    }
+    REQUIRE(prof.latency().count() == 10);
+  }
+  SECTION("unlabelled roots record one latency per parse") {
+    auto p = identifier->alt(integer)->many();
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      for (int k = 0; k < 10; k++) REQUIRE(p->parse("abc 12 d 3 ef").size() == 5);
+      REQUIRE_THROWS(p->keep_left(char_match(';'))->parse("abc +"));
+    }
+    REQUIRE(prof.latency().count() == 11);
+  }
+  SECTION("documents time parses from a state, nested ones are not counted") {
+    auto p = identifier->many();
+    profile::Profile prof;
+    {
+      profile::Scope on(prof);
+      for (int k = 0; k < 3; k++) {
+        const profile::Document doc;
+        state::StateView<> s("abc def");
+        REQUIRE(p->parse(s).size() == 2);
+        REQUIRE(p->parse("ghi").size() == 1);
+      }
+    }
+    REQUIRE(prof.latency().count() == 3);
+  }
+}
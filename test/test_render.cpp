@@ -0,0 +1,64 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <sstream>
+#include <string>
+
+using namespace parser::render;
+
+static Node sample() {
+  Node root("expr");
+  root.add_child(Node("1")).add_child(Node("op").add_child(Node("+")).add_child(Node("x_1")));
+  return root;
+}
+
+TEST_CASE("tree rendering") {
+  SECTION("s-expression") {
+    REQUIRE(Node("leaf").to_sexp() == "( leaf )");
+    REQUIRE(sample().to_sexp() == "( expr\n  ( 1 )\n  ( op\n    ( + )\n    ( x_1 ) ) )");
+    REQUIRE(sample().to_sexp(2) == "( expr\n    ( 1 )\n    ( op\n      ( + )\n      ( x_1 ) ) )");
+  }
+  SECTION("outline") {
+    REQUIRE(sample().to_stub() == "- expr\n  - 1\n  - op\n    - +\n    - x_1\n");
+  }
+  SECTION("latex") {
+    REQUIRE(sample().to_latex() == "\\Tree [.{expr}\n  [.{1} ]\n  [.{op}\n    [.{+} ]\n    [.{x\\_1} ] ] ]");
+    REQUIRE(Node("50% {a}").to_latex() == "\\Tree [.{50\\% \\{a\\}} ]");
+  }
+  SECTION("sinks agree") {
+    const Node root = sample();
+    std::ostringstream os;
+    StreamSink stream(os);
+    root.to_sexp(stream);
+    ChunkSink chunks;
+    root.to_sexp(chunks);
+    REQUIRE(os.str() == root.to_sexp());
+    REQUIRE(chunks.str() == root.to_sexp());
+    REQUIRE(chunks.size() == root.to_sexp().size());
+  }
+  SECTION("chunks reference tree text and copy written bytes") {
+    const Node root("abc");
+    ChunkSink chunks;
+    root.to_sexp(chunks);
+    REQUIRE(chunks.chunks().size() == 3);
+    REQUIRE(chunks.chunks()[1].base == static_cast<const Text &>(*root.data).text.data());
+    const std::string big(10000, 'x');
+    chunks.write("ab", 2);
+    chunks.write(big.data(), big.size());
+    chunks.write("cd", 2);
+    REQUIRE(chunks.str() == "( abc )ab" + big + "cd");
+  }
+  SECTION("deep and wide trees") {
+    const size_t depth = 5000;
+    Node root("n");
+    Node *n = &root;
+    for (size_t k = 1; k < depth; k++) n = &n->add_child(Node("n")).children.back();
+    const std::string str = root.to_sexp();
+    // "( n" and " )" per node, a newline and two spaces per level of indentation per child
+    REQUIRE(str.size() == depth * 5 + (depth - 1) + (depth - 1) * depth);
+    REQUIRE(str.compare(str.size() - 4, 4, " ) )") == 0);
+    Node wide("w");
+    for (size_t k = 0; k < 10000; k++) wide.add_child(Node(std::to_string(k)));
+    // "- w\n" then "  - ", the digits and a newline per child
+    REQUIRE(wide.to_stub().size() == 4 + 10000 * 5 + (10 * 1 + 90 * 2 + 900 * 3 + 9000 * 4));
+  }
+}
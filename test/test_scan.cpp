@@ -0,0 +1,62 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+using StateIStream = parser::state::StateIStream<>;
+
+static size_t naive_span(const std::bitset<256> &set, const std::string &str, size_t from) {
+  size_t i = from;
+  while (i < str.size() && set[(unsigned char)str[i]]) i++;
+  return i - from;
+}
+
+TEST_CASE("span scanning") {
+  std::bitset<256> digits, alnum, scattered;
+  for (int c = 0; c < 256; c++) {
+    digits[c] = c >= '0' && c <= '9';
+    alnum[c] = std::isalnum(c);
+    scattered[c] = c % 3 == 0 || c >= 200;
+  }
+  REQUIRE(scan::Class(digits).ranges == 1);
+  REQUIRE(scan::Class(alnum).ranges == 3);
+  REQUIRE(scan::Class(scattered).ranges == -1);
+  std::mt19937 rng(7);
+  for (const std::bitset<256> &set : {digits, alnum, scattered}) {
+    scan::Class cls(set);
+    for (int r = 0; r < 200; r++) {
+      std::string str;
+      const size_t run = rng() % 100;
+      while (str.size() < run) {
+        const char c = (char)(rng() % 256);
+        if (set[(unsigned char)c]) str += c;
+      }
+      for (int k = 0; k < 40; k++) str += (char)(rng() % 256);
+      for (size_t from : {(size_t)0, (size_t)(run / 2)})
+        REQUIRE(scan::span(cls, str.data() + from, str.size() - from) == naive_span(set, str, from));
+    }
+  }
+}
+
+TEST_CASE("repeated sat scans runs") {
+  std::string str = std::string(70, '7') + "x";
+  StateString s(&str);
+  REQUIRE(digit->many()->parse(s) == std::vector<char>(70, '7'));
+  REQUIRE(s.get_pos() == 70);
+  REQUIRE_THROWS(digit->some()->parse("x"));
+  SECTION("mapped sat is not scanned") {
+    auto upper_digit = digit->map<char>([](char c) { return (char)(c + 1); });
+    REQUIRE(upper_digit->many()->parse("12") == std::vector<char>{'2', '3'});
+  }
+  SECTION("take while") {
+    REQUIRE(take_while(digit_pred)->parse("123ab") == "123");
+    REQUIRE(spaces->parse("  \t\nx") == "  \t\n");
+    std::stringstream stream("123ab");
+    StateIStream si(&stream);
+    REQUIRE(take_while(digit_pred)->parse(si) == "123");
+  }
+}
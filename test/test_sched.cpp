@@ -0,0 +1,97 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+
+TEST_CASE("work stealing pool") {
+  sched::Pool pool(4);
+  REQUIRE(pool.size() == 4);
+  SECTION("runs every task once") {
+    std::vector<std::atomic<int>> hits(1000);
+    pool.run(hits.size(), [&](size_t t, size_t) { hits[t]++; });
+    for (auto &h : hits) REQUIRE(h == 1);
+  }
+  SECTION("repeated runs") {
+    std::atomic<int> sum(0);
+    for (int r = 0; r < 50; r++)
+      pool.run(10, [&](size_t t, size_t) { sum += t; });
+    REQUIRE(sum == 50 * 45);
+  }
+  SECTION("nested runs execute inline") {
+    std::atomic<int> sum(0);
+    pool.run(8, [&](size_t, size_t) {
+      pool.run(8, [&](size_t, size_t) { sum++; });
+    });
+    REQUIRE(sum == 64);
+  }
+}
+
+TEST_CASE("parallel many") {
+  sched::Pool pool(4);
+  SECTION("matches sequential many") {
+    std::string str;
+    for (int i = 0; i < 500; i++) str += std::to_string(i) + "\n";
+    auto seq = nat->seq<char>(char_match('\n'))->map<int>(alg::util::fst<int, char>)->many();
+    REQUIRE(nat->par_many('\n', pool)->parse(str) == seq->parse(str));
+  }
+  SECTION("stops at first failed record") {
+    std::string str = "1\n2\nx\n4\n";
+    StateString s(&str);
+    REQUIRE(nat->par_many('\n', pool)->parse(s) == std::vector<int>{1, 2});
+    REQUIRE(s.get_pos() == 4);
+  }
+  SECTION("partially consumed record fails") {
+    REQUIRE(nat->par_many('\n', pool)->parse("1\n2a\n").size() == 1);
+  }
+}
+
+TEST_CASE("parallel separated by") {
+  sched::Pool pool(4);
+  SECTION("elements up to stop") {
+    std::string str = "1,2,3]";
+    StateString s(&str);
+    REQUIRE(nat->par_sep_by(',', ']', pool)->parse(s) == std::vector<int>{1, 2, 3});
+    REQUIRE(s.get_pos() == 5);
+  }
+  SECTION("separator after last good element is not consumed") {
+    std::string str = "1,2,x";
+    StateString s(&str);
+    REQUIRE(nat->par_sep_by(',', '\0', pool)->parse(s) == std::vector<int>{1, 2});
+    REQUIRE(s.get_pos() == 3);
+  }
+  SECTION("empty") {
+    REQUIRE(nat->par_sep_by(',', ']', pool)->parse("]").empty());
+  }
+  SECTION("non parse exceptions propagate") {
+    auto stoi_nat = digit_some->map<int>(int_of_charvec);
+    REQUIRE_THROWS_AS(stoi_nat->par_sep_by(',', '\0', pool)->parse("1,99999999999"), std::out_of_range);
+  }
+}
+
+TEST_CASE("batch parse") {
+  sched::Pool pool(4);
+  std::vector<std::string> strs;
+  for (int i = 0; i < 300; i++) strs.push_back(i % 7 ? " " + std::to_string(i) + " " : "x");
+  std::vector<std::string_view> views(strs.begin(), strs.end());
+  SECTION("results in input order") {
+    std::vector<std::optional<int>> res = natural->parse_batch(views, pool);
+    REQUIRE(res.size() == strs.size());
+    for (int i = 0; i < 300; i++) {
+      REQUIRE(res[i].has_value() == (i % 7 != 0));
+      if (res[i]) REQUIRE(*res[i] == i);
+    }
+  }
+  SECTION("latencies") {
+    std::vector<uint64_t> lat;
+    natural->parse_batch(views, pool, &lat);
+    REQUIRE(lat.size() == strs.size());
+  }
+  SECTION("empty batch") {
+    REQUIRE(natural->parse_batch({}, pool).empty());
+  }
+}
@@ -0,0 +1,45 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+
+static_assert(std::is_const_v<decltype(Parser<int>::f)>, "parsing function is immutable");
+static_assert(std::is_const_v<decltype(Parser<int>::label)>, "label is immutable");
+
+TEST_CASE("shared grammar across threads") {
+  const Parser<std::vector<alg::Either<std::string_view, int>>> *grammar =
+    identifier->alt(integer)->many();
+  std::vector<std::string> inputs;
+  for (int i = 0; i < 64; i++) {
+    std::string str;
+    for (int j = 0; j < 50; j++) str += j % 2 ? " x" + std::to_string(i * j) : " " + std::to_string(i - j);
+    inputs.push_back(str);
+  }
+  std::vector<size_t> expected;
+  for (const std::string &str : inputs) expected.push_back(grammar->parse(str).size());
+
+  const int n = 8;
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(n, 0);
+  for (int t = 0; t < n; t++)
+    threads.emplace_back([&, t] {
+      for (int r = 0; r < 20; r++)
+        for (size_t k = 0; k < inputs.size(); k++) {
+          std::string str = inputs[(k + t) % inputs.size()];
+          StateString s(&str);
+          if (grammar->parse(s).size() != expected[(k + t) % inputs.size()]) mismatches[t]++;
+          try {
+            symbol("(")->parse(s);
+            mismatches[t]++;
+          } catch (Parser<std::string>::Fail &e) {}
+        }
+    });
+  for (std::thread &t : threads) t.join();
+  for (int m : mismatches) REQUIRE(m == 0);
+}
@@ -0,0 +1,186 @@
+#include "catch.hpp"
+#include "parser_combinator.h"
+#include <string>
+
+using namespace parser;
+using namespace parser::parsers;
+using StateString = parser::state::StateString<>;
+
+TEST_CASE("lowering combinators") {
+  SECTION("same extent as the parser") {
+    auto p = identifier->alt(integer)->many();
+    std::string str = " ab1 -12 c 3 +";
+    StateString s(&str);
+    p->parse(s);
+    vm::Match m = vm::run(p->compile(), str);
+    REQUIRE(m.ok);
+    REQUIRE(m.end == s.get_pos());
+  }
+  SECTION("failure") {
+    REQUIRE_FALSE(vm::run(natural->compile(), " x").ok);
+    REQUIRE_FALSE(vm::run(string_match("abc")->compile(), "ab").ok);
+  }
+  SECTION("ordered choice backtracks") {
+    auto p = string_match("ab")->alt(string_match("ac"));
+    REQUIRE(vm::run(p->compile(), "ac").end == 2);
+  }
+  SECTION("nullable repetition terminates") {
+    REQUIRE(vm::run(digit->many()->many()->compile(), "12a").end == 2);
+  }
+  SECTION("opaque parsers cannot be lowered") {
+    Parser<int> p([](state::State<> &s) { return 0; });
+    REQUIRE(p.pattern == nullptr);
+    REQUIRE_THROWS_AS(p.compile(), std::invalid_argument);
+    REQUIRE(digit->par_many('\n')->pattern == nullptr);
+  }
+}
+
+TEST_CASE("runtime grammars") {
+  std::bitset<256> lower_set;
+  for (char c = 'a'; c <= 'z'; c++) lower_set.set(c);
+  SECTION("captures") {
+    vm::Pat word = vm::capture(vm::seq(vm::set(lower_set), vm::star(vm::set(lower_set))));
+    vm::Pat p = vm::seq(word, vm::star(vm::seq(vm::lit(", "), word)));
+    vm::Match m = vm::run(vm::compile(p), "ab, cd, e!");
+    REQUIRE(m.ok);
+    REQUIRE(m.end == 9);
+    REQUIRE(m.caps.size() == 3);
+    REQUIRE(m.caps[0] == "ab");
+    REQUIRE(m.caps[1] == "cd");
+    REQUIRE(m.caps[2] == "e");
+  }
+  SECTION("captures inside failed branches are dropped") {
+    vm::Pat p = vm::choice(vm::seq(vm::capture(vm::lit("a")), vm::lit("b")), vm::capture(vm::lit("ac")));
+    vm::Match m = vm::run(vm::compile(p), "ac");
+    REQUIRE(m.caps.size() == 1);
+    REQUIRE(m.caps[0] == "ac");
+  }
+  SECTION("deep recursion") {
+    vm::Program prog = vm::compile(vm::ref("s"), {
+      {"s", vm::seq(vm::lit("("), vm::seq(vm::star(vm::ref("s")), vm::lit(")")))}});
+    const size_t depth = 200000;
+    std::string str = std::string(depth, '(') + std::string(depth, ')');
+    REQUIRE(vm::run(prog, str).end == str.size());
+    REQUIRE_FALSE(vm::run(prog, str.substr(0, str.size() - 1)).ok);
+  }
+  SECTION("undefined rule") {
+    REQUIRE_THROWS_AS(vm::compile(vm::ref("x")), std::invalid_argument);
+  }
+}
+
+TEST_CASE("grammar rules") {
+  SECTION("recursive grammars lower to bytecode") {
+    auto parens = rule<size_t>("parens");
+    parens->define(char_match('(')->keep_right(parens->skip_many())->keep_left(char_match(')')));
+    REQUIRE(parens->parse("(()())") == 2);
+    Validator<size_t> v(parens);
+    REQUIRE(v.compiled());
+    const size_t depth = 200000;
+    REQUIRE(v.check_all(std::string(depth, '(') + std::string(depth, ')')).ok);
+    Verdict bad = v.check_all(std::string(depth, '(') + std::string(depth - 1, ')'));
+    REQUIRE_FALSE(bad.ok);
+    REQUIRE(bad.pos == 2 * depth - 1);
+  }
+  SECTION("parse and vm agree") {
+    auto expr = rule<int>("expr");
+    auto atom = between(symbol("("), expr, symbol(")"))->alt(integer)->map<int>(alg::util::get_either<int>);
+    expr->define(atom->seq<int, int>(symbol("+")->keep_right(atom)->fold_many<int>(0, [](int a, int x) { return a + x; }),
+      [](int x, int y) { return x + y; }));
+    for (std::string str : {"1 + (2 + 3) + 4", "(((7)))", "1 + (2 +", "(1 + 2) x"}) {
+      StateString s(&str);
+      bool ok = true;
+      try {
+        expr->parse(s);
+      } catch (Parser<int>::Fail &e) {
+        ok = false;
+      }
+      vm::Match m = vm::run(expr->compile(), str);
+      REQUIRE(m.ok == ok);
+      if (ok) REQUIRE(m.end == s.get_pos());
+    }
+    REQUIRE(expr->parse("1 + (2 + 3) + 4") == 10);
+  }
+  SECTION("recognizing a recursive grammar runs no actions") {
+    int actions = 0;
+    auto list = rule<int>("list");
+    auto item = identifier->map<int>([&actions](std::string_view) { return ++actions; })
+      ->alt(between(symbol("["), list, symbol("]")))->map<int>([&actions](auto) { return ++actions; });
+    auto span = capture(between(symbol("["), list, symbol("]")));
+    list->define(item->keep_left(symbol(",")->keep_right(item)->skip_many()));
+    const std::string str = "[a, [b, [c, d]], e]";
+    Validator<int> v(list);
+    REQUIRE(v.compiled());
+    REQUIRE(v.check_all("a, [b, [c, d]], e").ok);
+    REQUIRE_FALSE(v.check_all("a, [b, [c, d], e").ok);
+    REQUIRE(span->parse(str) == str);
+    REQUIRE(actions == 0);
+    list->parse("a, [b]");
+    REQUIRE(actions > 0);
+  }
+  SECTION("undefined rules are opaque") {
+    auto r = rule<char>("r");
+    auto p = r->many();
+    REQUIRE(p->program() == nullptr);
+    REQUIRE_THROWS_AS(r->parse("a"), std::logic_error);
+    r->define(letter);
+    REQUIRE(p->program() != nullptr);
+    REQUIRE(p->parse("ab1").size() == 2);
+  }
+}
+
+TEST_CASE("recognize-only validation") {
+  SECTION("runs of a class scan in one instruction") {
+    vm::Program prog = vm::compile(vm::star(vm::set(chars::digit.bits())));
+    REQUIRE(prog.code.size() == 2);
+    REQUIRE(prog.code[0].op == vm::Op::Span);
+    std::string str(100, '7');
+    REQUIRE(vm::run(prog, str + "x").end == 100);
+  }
+  SECTION("farthest failure") {
+    auto p = identifier->seq(symbol("="))->seq(integer);
+    vm::Match m = vm::run(p->compile(), "abc = x");
+    REQUIRE_FALSE(m.ok);
+    REQUIRE(m.far == 6);
+  }
+  SECTION("validator") {
+    auto p = identifier->seq(symbol("="))->seq(integer)->map<int>([](auto) -> int { throw std::logic_error("action ran"); });
+    Validator<int> v(p);
+    REQUIRE(v.compiled());
+    REQUIRE(v.check("x = 12").ok);
+    REQUIRE(v.check("x = 12").pos == 6);
+    Verdict bad = v.check("x = y");
+    REQUIRE_FALSE(bad.ok);
+    REQUIRE(bad.pos == 4);
+    REQUIRE_FALSE(v.check_all("x = 12 ;").ok);
+    REQUIRE(v.check_all("x = 12 ;").pos == 7);
+  }
+  SECTION("validator advances the state") {
+    Validator<std::vector<char>> v(digit->many());
+    std::string str = "123a";
+    StateString s(&str);
+    REQUIRE(v.check(s).ok);
+    REQUIRE(s.get_pos() == 3);
+  }
+  SECTION("opaque grammars fall back to parsing") {
+    Validator<std::vector<int>> v(nat->par_sep_by(','));
+    REQUIRE_FALSE(v.compiled());
+    REQUIRE(v.check("1,2,3").ok);
+    REQUIRE(v.check("1,2,3").pos == 5);
+    auto q = char_match('[')->keep_right(nat->par_sep_by(','))->keep_left(char_match(']'));
+    Verdict bad = Validator<std::vector<int>>(q).check("[1,2;");
+    REQUIRE_FALSE(bad.ok);
+    REQUIRE(bad.pos == 2);
+  }
+  SECTION("semantic checks are not skipped") {
+    auto small = nat->check("small", [](const int &x) { return x <= 100; });
+    REQUIRE(small->pattern == nullptr);
+    REQUIRE(small->parse("50") == 50);
+    REQUIRE_FALSE(Validator<int>(small).check_all("500").ok);
+    REQUIRE_THROWS(capture(small)->parse("500"));
+    REQUIRE_THROWS(small->keep_right(char_match('x'))->parse("500x"));
+    std::string str = "500";
+    StateString s(&str);
+    REQUIRE_THROWS(small->parse(s));
+    REQUIRE(s.get_pos() == 0);
+  }
+}